@@ -27,6 +27,11 @@ int main(void)	{
   printString(buf);
  
   while (1){
+    // read right after seconds rollover instead of random phase.
+    // printing below takes a few tens of ms at 9600 baud, so sleep
+    // through most of the second and poll only shortly before next one
+    _delay_ms(900);
+    rtc2_wait_second_edge();
     rtc2_update(RTC2_VALUE);
 
     sprintf(buf, "%02i/%02i/20%02i %02i:%02i:%02i %02s\r\n",
@@ -35,8 +40,6 @@ int main(void)	{
         RTC2_VALUE->format == RTC2_FORMAT_PM ? "PM" : "AM");
 
     printString(buf);
-
-    _delay_ms(1000);
   }
 
   return 0;
@@ -4,10 +4,14 @@
 
 #include "rtc2.h"
 
-#if RTC2_RAM_STRINGS
+#if RTC2_RAM_STRINGS || RTC2_TZ || RTC2_LOG
 #include <string.h>
 #endif
 
+#if RTC2_TZ
+#include <avr/pgmspace.h>
+#endif
+
 // Registers addresses from datasheet {{{
 #define RTC2_SECONDS_READ  0x81
 #define RTC2_SECONDS_WRITE 0x80
@@ -43,17 +47,37 @@
 #define RTC2_BURST_MEM_WRITE 0xFE
 // }}}
 
+// Bus trace hook. every pin change is logged when RTC2_TRACE is on {{{
+// timestamp is taken right before the pin access, so every entry is
+// logged a constant few cycles early. logging itself runs after the
+// access and delays the rest of transfer, see rtc2_trace_overhead.
+#if RTC2_TRACE
+static uint16_t rtc2_trace_time;
+static uint8_t rtc2_trace_edge(uint8_t flags);
+#define RTC2_TRACE_EDGE(op, flags) (rtc2_trace_time = RTC2_TRACE_TIME, (op), rtc2_trace_edge(flags))
+#else
+#define RTC2_TRACE_EDGE(op, flags) (op)
+#endif
+// }}}
+
 // RTC2 utility macro handling I/O {{{
-#define RTC2_IO_OUTPUT (RTC2_DDR |= _BV(RTC2_IO))
-#define RTC2_IO_INPUT (RTC2_DDR &= ~_BV(RTC2_IO))
-#define RTC2_IO_HIGH (RTC2_PORT |= _BV(RTC2_IO))
-#define RTC2_IO_LOW (RTC2_PORT &= ~_BV(RTC2_IO))
+#define RTC2_IO_OUTPUT RTC2_TRACE_EDGE(RTC2_DDR |= _BV(RTC2_IO), 0)
+#define RTC2_IO_INPUT RTC2_TRACE_EDGE(RTC2_DDR &= ~_BV(RTC2_IO), 0)
+#define RTC2_IO_HIGH RTC2_TRACE_EDGE(RTC2_PORT |= _BV(RTC2_IO), 0)
+#define RTC2_IO_LOW RTC2_TRACE_EDGE(RTC2_PORT &= ~_BV(RTC2_IO), 0)
+
+#if RTC2_TRACE
+// pin is read by the logging itself, right after timestamp
+#define RTC2_IO_SAMPLE (rtc2_trace_time = RTC2_TRACE_TIME, rtc2_trace_edge(RTC2_TRACE_SAMPLE) & RTC2_TRACE_IO)
+#else
+#define RTC2_IO_SAMPLE bit_is_set(RTC2_PIN, RTC2_IO)
+#endif
 
-#define RTC2_CLK_HIGH (RTC2_PORT |= _BV(RTC2_CLK))
-#define RTC2_CLK_LOW (RTC2_PORT &= ~_BV(RTC2_CLK))
+#define RTC2_CLK_HIGH RTC2_TRACE_EDGE(RTC2_PORT |= _BV(RTC2_CLK), 0)
+#define RTC2_CLK_LOW RTC2_TRACE_EDGE(RTC2_PORT &= ~_BV(RTC2_CLK), 0)
 
-#define RTC2_CE_HIGH (RTC2_PORT |= _BV(RTC2_CE))
-#define RTC2_CE_LOW (RTC2_PORT &= ~_BV(RTC2_CE))
+#define RTC2_CE_HIGH RTC2_TRACE_EDGE(RTC2_PORT |= _BV(RTC2_CE), 0)
+#define RTC2_CE_LOW RTC2_TRACE_EDGE(RTC2_PORT &= ~_BV(RTC2_CE), 0)
 
 #define RTC2_MEM_END_WRITE (RTC2_MEM_END - 1)
 #define RTC2_MEM_START_WRITE (RTC2_MEM_START - 1)
@@ -66,8 +90,82 @@
 // }}}
 
 // Default global pointer memory {{{
-#if RTC2_DEFAULT && (RTC2_READ || RTC2__WRITE)
+#if RTC2_DEFAULT && (RTC2_READ || RTC2_WRITE)
 static rtc2_datetime_t rtc2_default = {0};
+volatile rtc2_datetime RTC2_VALUE;
+#endif
+// }}}
+
+// Bus trace ring buffer {{{
+#if RTC2_TRACE
+
+static rtc2_trace_entry_t rtc2_trace_buf[RTC2_TRACE_SIZE];
+static uint8_t rtc2_trace_head = 0;
+static uint8_t rtc2_trace_len = 0;
+static uint16_t rtc2_trace_cost = 0;
+
+// all pins are read unconditionally so that every entry takes
+// about the same time. returns flags, IO bit is the sampled level.
+static uint8_t rtc2_trace_edge(uint8_t flags){
+  rtc2_trace_entry_t *e = &rtc2_trace_buf[rtc2_trace_head];
+  uint8_t port = RTC2_PORT, ddr = RTC2_DDR, pin = RTC2_PIN;
+
+  if(port & _BV(RTC2_CE))
+    flags |= RTC2_TRACE_CE;
+
+  if(port & _BV(RTC2_CLK))
+    flags |= RTC2_TRACE_CLK;
+
+  if(ddr & _BV(RTC2_IO)){
+    flags |= RTC2_TRACE_IO_OUT;
+    pin = port;
+  }
+
+  if(pin & _BV(RTC2_IO))
+    flags |= RTC2_TRACE_IO;
+
+  e->time = rtc2_trace_time;
+  e->flags = flags;
+
+  if(++rtc2_trace_head == RTC2_TRACE_SIZE)
+    rtc2_trace_head = 0;
+
+  if(rtc2_trace_len < RTC2_TRACE_SIZE)
+    ++rtc2_trace_len;
+
+  return flags;
+}
+
+uint8_t rtc2_trace_count(void){
+  return rtc2_trace_len;
+}
+
+const rtc2_trace_entry_t *rtc2_trace_get(uint8_t i){
+  uint16_t idx;
+
+  if(i >= rtc2_trace_len)
+    return NULL;
+
+  // oldest entry is right after head once buffer wrapped
+  idx = rtc2_trace_head + RTC2_TRACE_SIZE - rtc2_trace_len + i;
+
+  return &rtc2_trace_buf[idx % RTC2_TRACE_SIZE];
+}
+
+// two entries with nothing in between are apart exactly by the
+// time logging adds to a transfer
+void rtc2_trace_clear(void){
+  RTC2_TRACE_EDGE((void)0, 0);
+  RTC2_TRACE_EDGE((void)0, 0);
+
+  rtc2_trace_cost = rtc2_trace_get(rtc2_trace_len - 1)->time - rtc2_trace_get(rtc2_trace_len - 2)->time;
+  rtc2_trace_head = rtc2_trace_len = 0;
+}
+
+uint16_t rtc2_trace_overhead(void){
+  return rtc2_trace_cost;
+}
+
 #endif
 // }}}
 
@@ -79,23 +177,31 @@ void rtc2_init(void){
   RTC2_PORT &= ~(_BV(RTC2_CE) | _BV(RTC2_CLK) | _BV(RTC2_IO));
 
   // initialize default global pointer if needed
-#if RTC2_DEFAULT && (RTC2_READ || RTC2__WRITE)
+#if RTC2_DEFAULT && (RTC2_READ || RTC2_WRITE)
   RTC2_VALUE = &rtc2_default;
 #endif
+
+#if RTC2_TRACE
+  rtc2_trace_clear();
+#endif
 }
 // }}}
 
 // Utility stuff used to reset current transfer state {{{
 static inline void rtc2_reset(void){
   RTC2_STOP_TRANSMISSION;
+  // CE inactive time (tCWH) and CE to first SCLK rise (tCC) are
+  // 4us at 2V, pin writes alone are far shorter on a fast MCU
+  _delay_us(4);
   RTC2_CE_HIGH;
+  _delay_us(4);
 }
 // }}}
 
 // Low level write functions {{{
 
 // Routine used for pretty much any operation {{{
-#if RTC2_READ || RTC2_WRITE ||RTC2_RAM || RTC2_UTILITY
+#if RTC2_READ || RTC2_WRITE ||RTC2_RAM || RTC2_UTILITY || RTC2_HEALTH
 static void rtc2_write_byte(uint8_t byte){
   uint8_t i;
 
@@ -132,7 +238,7 @@ static void rtc2_write(uint8_t reg, uint8_t val){
 // }}}
 
 // Low level read functions {{{
-#if RTC2_READ || RTC2_UTILITY || RTC2_RAM
+#if RTC2_READ || RTC2_UTILITY || RTC2_RAM || RTC2_HEALTH
 
 static uint8_t rtc2_read_byte(void){
   uint8_t i, ret = 0;
@@ -146,7 +252,7 @@ static uint8_t rtc2_read_byte(void){
     _delay_us(2);
     ret >>= 1;
 
-    if(bit_is_set(RTC2_PIN, RTC2_IO))
+    if(RTC2_IO_SAMPLE)
       ret |= _BV(7);
   }
 
@@ -175,13 +281,18 @@ void rtc2_preset(rtc2_datetime ptr){
 // we have to cut off higher parts to avoid accidently
 // setting control bits.
 static uint8_t rtc2_store_field(uint8_t field, uint8_t val){
+  uint8_t format;
+
   switch(field){
     case RTC2_SECONDS_WRITE:
     case RTC2_MINUTES_WRITE:
       val = (((val / 10) << 4) & 0x70) | (val % 10);
       break;
     case RTC2_HOURS_WRITE:
-      val = (val & RTC2_FORMAT_PM) | (((val / 10) << 4) & 0x10) | (val % 10);
+      // 10 hours field is 1 bit wide in 12 hours mode and 2 bits in 24
+      format = val & RTC2_FORMAT_PM;
+      val &= ~RTC2_FORMAT_PM;
+      val = format | (((val / 10) << 4) & (format ? 0x10 : 0x30)) | (val % 10);
       break;
     case RTC2_DATE_WRITE:
       val = (((val / 10) << 4) & 0x30) | (val % 10);
@@ -190,7 +301,7 @@ static uint8_t rtc2_store_field(uint8_t field, uint8_t val){
       val = (((val / 10) << 4) & 0x10) | (val % 10);
       break;
     case RTC2_WDAY_WRITE:
-      val &= 0x03;
+      val &= 0x07;
       break;
     case RTC2_YEAR_WRITE:
       val = (((val / 10) << 4) & 0xF0) | (val % 10);
@@ -206,7 +317,7 @@ static void rtc2_set_val(uint8_t field, uint8_t val){
 
 void rtc2_set(rtc2_datetime ptr, uint8_t fields){
 #if RTC2_BURST
-  if(fields & RTC2_ALL_FIELDS){
+  if((fields & RTC2_ALL_FIELDS) == RTC2_ALL_FIELDS){
     RTC2_START_TRANSMISSION(RTC2_BURST_WRITE);
 
     rtc2_write_byte(rtc2_store_field(RTC2_SECONDS_WRITE, ptr->seconds));
@@ -256,11 +367,23 @@ void rtc2_update(rtc2_datetime ptr){
   rtc2_get(ptr, RTC2_ALL_FIELDS);
 }
 
+#if RTC2_HEALTH
+// set when a register had units digit above 9, which no valid BCD
+// value has. range check after decoding can't see that, 0x1A seconds
+// decodes to 20.
+static uint8_t rtc2_bcd_error = 0;
+#endif
+
 // decode values received from DS1302 from BCD to bin encoding.
 // see datasheet for details. because some registers
 // contain also control bits we cut off higher parts
 // that are not data.
 static uint8_t rtc2_parse_val(uint8_t field, uint8_t val){
+#if RTC2_HEALTH
+  if((val & 0x0F) > 9)
+    rtc2_bcd_error = 1;
+#endif
+
   switch(field){
     case RTC2_SECONDS_READ:
     case RTC2_MINUTES_READ:
@@ -268,7 +391,10 @@ static uint8_t rtc2_parse_val(uint8_t field, uint8_t val){
       break;
     case RTC2_HOURS_READ:
       // hours format is passed along with the hour itself
-      val = (val & RTC2_FORMAT_PM) | ((val & 0x0F) + ((val & 0x10) >> 4) * 10);
+      if(val & RTC2_FORMAT_AM)
+        val = (val & RTC2_FORMAT_PM) | ((val & 0x0F) + ((val & 0x10) >> 4) * 10);
+      else
+        val = (val & 0x0F) + ((val & 0x30) >> 4) * 10;
       break;
     case RTC2_DATE_READ:
       val = (val & 0x0F) + ((val & 0x30) >> 4) * 10;
@@ -293,7 +419,7 @@ static uint8_t rtc2_get_val(uint8_t field){
 
 void rtc2_get(rtc2_datetime ptr, uint8_t fields){
 #if RTC2_BURST
-  if(fields & RTC2_ALL_FIELDS){
+  if((fields & RTC2_ALL_FIELDS) == RTC2_ALL_FIELDS){
     uint8_t tmp;
 
     RTC2_START_TRANSMISSION(RTC2_BURST_READ);
@@ -342,6 +468,103 @@ void rtc2_get(rtc2_datetime ptr, uint8_t fields){
 #endif
 }
 
+// Second boundary synchronization {{{
+#if RTC2_SYNC
+
+// a bit more than a second worth of polls, reads themselves
+// make it even longer. counted in 32 bits, short intervals give
+// more than 65535 polls
+#define RTC2_SYNC_MAX_POLLS (1100000UL / RTC2_SYNC_POLL_US)
+
+uint8_t rtc2_wait_second_edge(void){
+  uint8_t first = rtc2_read(RTC2_SECONDS_READ), cur;
+  uint32_t i;
+
+  for(i = 0; i < RTC2_SYNC_MAX_POLLS; ++i){
+    _delay_us(RTC2_SYNC_POLL_US);
+    cur = rtc2_read(RTC2_SECONDS_READ);
+
+    if(cur != first)
+      return rtc2_parse_val(RTC2_SECONDS_READ, cur);
+  }
+
+  return RTC2_SYNC_TIMEOUT;
+}
+
+#if RTC2_SYNC_TRACK
+
+// same as above but also timestamps the edge. rollover happened between
+// previous and current read, so take the middle.
+static uint8_t rtc2_sync_find(rtc2_sync_t *s){
+  uint8_t first = rtc2_read(RTC2_SECONDS_READ), cur;
+  uint32_t before = RTC2_SYNC_TIME, after;
+  uint32_t i;
+
+  for(i = 0; i < RTC2_SYNC_MAX_POLLS; ++i){
+    _delay_us(RTC2_SYNC_POLL_US);
+    cur = rtc2_read(RTC2_SECONDS_READ);
+    after = RTC2_SYNC_TIME;
+
+    if(cur != first){
+      s->edge = before + (after - before) / 2;
+      s->seconds = rtc2_parse_val(RTC2_SECONDS_READ, cur);
+      return s->seconds;
+    }
+
+    before = after;
+  }
+
+  return RTC2_SYNC_TIMEOUT;
+}
+
+uint8_t rtc2_sync_init(rtc2_sync_t *s){
+  s->period = RTC2_SYNC_TICKS_PER_SECOND;
+  return rtc2_sync_find(s);
+}
+
+uint32_t rtc2_sync_next(const rtc2_sync_t *s){
+  // first predicted rollover after now
+  uint32_t n = (RTC2_SYNC_TIME - s->edge) / s->period + 1;
+
+  return s->edge + n * s->period - RTC2_SYNC_GUARD;
+}
+
+uint8_t rtc2_sync_wait(rtc2_sync_t *s){
+  uint32_t prev = s->edge, n, count, period;
+  uint8_t prev_seconds = s->seconds, diff;
+
+  if(rtc2_sync_find(s) == RTC2_SYNC_TIMEOUT)
+    return RTC2_SYNC_TIMEOUT;
+
+  // predicted number of rollovers since last edge
+  n = (s->edge - prev + s->period / 2) / s->period;
+
+  // rollovers actually seen. seconds register gives them modulo 60,
+  // take the count closest to predicted one
+  diff = (s->seconds + 120 - prev_seconds - n % 60) % 60;
+  count = diff < 30 ? n + diff : n + diff - 60;
+
+  if(!count || count > n + 30)
+    count += 60;
+
+  period = (s->edge - prev) / count;
+
+  // edge came within guard window as predicted, so only smooth out
+  // poll granularity. otherwise MCU timer is further off than the
+  // guard covers and old period is useless.
+  if(count == n && s->edge - (prev + n * s->period - RTC2_SYNC_GUARD) <= 2 * RTC2_SYNC_GUARD)
+    s->period += ((int32_t)(period - s->period)) / 8;
+  else
+    s->period = period;
+
+  return s->seconds;
+}
+
+#endif
+
+#endif
+// }}}
+
 // UNIX timestamp utilities {{{
 #if RTC2_TIMESTAMP
 
@@ -441,6 +664,98 @@ uint8_t rtc2_localtime(rtc2_datetime dst, uint32_t timestamp){
   return 1;
 }
 
+// Timezone conversion {{{
+#if RTC2_TZ
+
+// local time of transition given by rule in given year
+static uint32_t rtc2_tz_transition(const rtc2_tz_rule_t *rule, uint8_t year){
+  uint32_t ret = rtc2_mktime(0, 0, 0, 1, rule->month, year);
+  uint8_t day, len = rtc2_monthes[rule->month - 1];
+
+  if(rule->month == 2 && year % 4 == 0)
+    ++len;
+
+  // weekday of the 1st, 0 is Sunday. 1st January 2000 is Saturday
+  day = ((ret - RTC2_BASE_TIMESTAMP) / (24L * 60 * 60) + 6) % 7;
+  // first requested weekday of month and then requested week
+  day = 1 + (rule->wday + 7 - day) % 7 + (rule->week - 1) * 7;
+
+  // week 5 means last one
+  if(day > len)
+    day -= 7;
+
+  return ret + (day - 1) * 24L * 60 * 60 + rule->minutes * 60L;
+}
+
+// recalculates cache for year of given UTC timestamp
+static void rtc2_tz_update(rtc2_tz_cache_t *cache, uint32_t utc){
+  rtc2_datetime_t tmp;
+  rtc2_tz_t tz;
+
+  memcpy_P(&tz, cache->tz, sizeof(tz));
+
+  if(!rtc2_localtime(&tmp, utc))
+    tmp.year = 0;
+
+  cache->from = rtc2_mktime(0, 0, 0, 1, 1, tmp.year);
+  cache->to   = rtc2_mktime(0, 0, 0, 1, 1, tmp.year + 1);
+  cache->std  = tz.std_offset * 60L;
+  cache->dst  = tz.dst_offset * 60L;
+
+  if(tz.std_offset == tz.dst_offset){
+    // no DST at all, both comparisons will always fail
+    cache->start = cache->end = 0;
+    return;
+  }
+
+  // start is given in standard time and end in daylight time
+  cache->start = rtc2_tz_transition(&tz.start, tmp.year) - cache->std;
+  cache->end   = rtc2_tz_transition(&tz.end, tmp.year) - cache->dst;
+}
+
+void rtc2_tz_init(rtc2_tz_cache_t *cache, const rtc2_tz_t *tz){
+  cache->tz = tz;
+  // empty range, so first conversion fills the cache
+  cache->from = cache->to = 0;
+}
+
+uint32_t rtc2_utc_to_local(rtc2_tz_cache_t *cache, uint32_t utc){
+  if(utc < cache->from || utc >= cache->to)
+    rtc2_tz_update(cache, utc);
+
+  // on southern hemisphere DST spans new year
+  if(cache->start <= cache->end){
+    if(utc >= cache->start && utc < cache->end)
+      return utc + cache->dst;
+  }else if(utc >= cache->start || utc < cache->end)
+    return utc + cache->dst;
+
+  return utc + cache->std;
+}
+
+uint32_t rtc2_local_to_utc(rtc2_tz_cache_t *cache, uint32_t local){
+  uint32_t utc = local - cache->std;
+
+  if(utc < cache->from || utc >= cache->to)
+    rtc2_tz_update(cache, utc);
+
+  // same checks as above but in daylight time. skipped hour at DST
+  // start is treated as standard time, repeated hour at DST end as
+  // daylight time (the earlier one).
+  local -= cache->dst;
+
+  if(cache->start <= cache->end){
+    if(local >= cache->start && local < cache->end)
+      return local;
+  }else if(local >= cache->start || local < cache->end)
+    return local;
+
+  return utc;
+}
+
+#endif
+// }}}
+
 #endif
 // }}}
 
@@ -519,6 +834,68 @@ void rtc2_mem_read(uint8_t offset, size_t size, void *buffer){
 #endif
 }
 
+// RAM streaming functions {{{
+#if RTC2_RAM_STREAM
+
+void rtc2_mem_stream(uint8_t offset, size_t size, rtc2_mem_sink sink, void *ctx){
+  offset += RTC2_MEM_START;
+
+  // with 16 bit size_t (size - 1) * 2 wraps for size 0 and passes
+  if(!size || RTC2_MEM_READ_INVALID(offset) || RTC2_MEM_READ_INVALID(offset + (size - 1) * 2))
+    return;
+
+#if RTC2_BURST
+  // burst always starts from the first RAM byte. clocking out
+  // a skipped byte costs 8 clocks while single byte read costs 16
+  // and CE toggling, so skip while prefix is shorter than the chunk.
+  uint8_t skip = (offset - RTC2_MEM_START) / 2;
+
+  if(size > 1 && skip + 1 < size){
+    RTC2_START_TRANSMISSION(RTC2_BURST_MEM_READ);
+
+    for(; skip > 0; --skip)
+      rtc2_read_byte();
+
+    for(; size > 0; --size)
+      sink(rtc2_read_byte(), ctx);
+
+    RTC2_STOP_TRANSMISSION;
+  }else{
+#endif
+    for(; size > 0; offset += 2, --size)
+      sink(rtc2_read(offset), ctx);
+#if RTC2_BURST
+  }
+#endif
+}
+
+void rtc2_mem_fill(uint8_t offset, size_t size, rtc2_mem_source source, void *ctx){
+  offset += RTC2_MEM_START_WRITE;
+
+  if(!size || RTC2_MEM_WRITE_INVALID(offset) || RTC2_MEM_WRITE_INVALID(offset + (size - 1) * 2))
+    return;
+
+#if RTC2_BURST
+  // unlike reading we can't skip bytes here, that would overwrite them
+  if(size > 2 && offset == RTC2_MEM_START_WRITE){
+    RTC2_START_TRANSMISSION(RTC2_BURST_MEM_WRITE);
+
+    for(; size > 0; --size)
+      rtc2_write_byte(source(ctx));
+
+    RTC2_STOP_TRANSMISSION;
+  }else{
+#endif
+    for(; size > 0; offset += 2, --size)
+      rtc2_write(offset, source(ctx));
+#if RTC2_BURST
+  }
+#endif
+}
+
+#endif
+// }}}
+
 // RAM string functions {{{
 #if RTC2_RAM_STRINGS
 
@@ -579,3 +956,480 @@ void rtc2_set_protection(uint8_t v){
 
 #endif
 // }}}
+
+// Bus health checks {{{
+#if RTC2_HEALTH
+
+// calls left to skip and current backoff length
+static uint8_t rtc2_health_skip = 0;
+static uint8_t rtc2_health_backoff = 0;
+
+static void rtc2_health_fail(void){
+  if(rtc2_health_backoff > RTC2_HEALTH_MAX_BACKOFF / 2)
+    rtc2_health_backoff = RTC2_HEALTH_MAX_BACKOFF;
+  else if(rtc2_health_backoff)
+    rtc2_health_backoff *= 2;
+  else
+    rtc2_health_backoff = 1;
+
+  rtc2_health_skip = rtc2_health_backoff;
+}
+
+uint8_t rtc2_probe(void){
+  // only WP bit may be set in this register, the rest always reads
+  // as zeroes. I/O stuck high gives 0xFF here.
+  if(rtc2_read(RTC2_WP_READ) & 0x7F)
+    return RTC2_ERR_BUS;
+
+#if RTC2_HEALTH_CANARY && RTC2_RAM
+  // stuck low (or missing chip with pull down) reads as all zeroes
+  if(rtc2_mem_read_byte(RTC2_HEALTH_CANARY_OFFSET) != RTC2_HEALTH_CANARY_VALUE)
+    return RTC2_ERR_BUS;
+#endif
+
+  return RTC2_OK;
+}
+
+#if RTC2_HEALTH_CANARY && RTC2_RAM
+void rtc2_health_init(void){
+  rtc2_mem_write_byte(RTC2_HEALTH_CANARY_OFFSET, RTC2_HEALTH_CANARY_VALUE);
+}
+#endif
+
+// honors backoff and probes bus, common part of all checked functions
+static uint8_t rtc2_health_enter(void){
+  if(rtc2_health_skip){
+    --rtc2_health_skip;
+    return RTC2_ERR_BACKOFF;
+  }
+
+  if(rtc2_probe() != RTC2_OK){
+    rtc2_health_fail();
+    return RTC2_ERR_BUS;
+  }
+
+  rtc2_health_backoff = 0;
+  return RTC2_OK;
+}
+
+#if RTC2_READ
+
+// verifies only fields that were read. wday is not checked: register
+// is 3 bits wide and both 0..6 (rtc2_localtime) and 1..7 are in use
+static uint8_t rtc2_fields_valid(rtc2_datetime ptr, uint8_t fields){
+  if((fields & RTC2_SECONDS_FIELD) && ptr->seconds > 59)
+    return 0;
+
+  if((fields & RTC2_MINUTES_FIELD) && ptr->minutes > 59)
+    return 0;
+
+  if(fields & RTC2_HOURS_FIELD){
+    if(ptr->format & RTC2_FORMAT_AM){
+      if(ptr->hours < 1 || ptr->hours > 12)
+        return 0;
+    }else if(ptr->hours > 23)
+      return 0;
+  }
+
+  if((fields & RTC2_DATE_FIELD) && (ptr->date < 1 || ptr->date > 31))
+    return 0;
+
+  if((fields & RTC2_MONTH_FIELD) && (ptr->month < 1 || ptr->month > 12))
+    return 0;
+
+  if((fields & RTC2_YEAR_FIELD) && ptr->year > 99)
+    return 0;
+
+  return 1;
+}
+
+uint8_t rtc2_get_checked(rtc2_datetime ptr, uint8_t fields){
+  uint8_t ret = rtc2_health_enter();
+
+  if(ret != RTC2_OK)
+    return ret;
+
+  rtc2_bcd_error = 0;
+  rtc2_get(ptr, fields);
+
+  // garbage that passed the probe is still a bus problem,
+  // so back off as well
+  if(rtc2_bcd_error || !rtc2_fields_valid(ptr, fields)){
+    rtc2_health_fail();
+    return RTC2_ERR_RANGE;
+  }
+
+  return RTC2_OK;
+}
+
+#endif
+
+#if RTC2_RAM
+
+uint8_t rtc2_mem_read_checked(uint8_t offset, size_t size, void *buffer){
+  uint8_t ret, addr = offset + RTC2_MEM_START;
+
+  if(RTC2_MEM_READ_INVALID(addr) || RTC2_MEM_READ_INVALID(addr + size * 2))
+    return RTC2_ERR_ARGS;
+
+  ret = rtc2_health_enter();
+
+  if(ret == RTC2_OK)
+    rtc2_mem_read(offset, size, buffer);
+
+  return ret;
+}
+
+#endif
+
+#endif
+// }}}
+
+// Drift calibration {{{
+#if RTC2_CALIB
+
+// stored as low byte, high byte and check byte
+#define RTC2_CALIB_CHECK(lo, hi) ((lo) ^ (hi) ^ 0x5A)
+
+void rtc2_calib_init(rtc2_calib_t *c){
+  uint8_t lo = rtc2_mem_read_byte(RTC2_CALIB_OFFSET),
+          hi = rtc2_mem_read_byte(RTC2_CALIB_OFFSET + 2);
+
+  c->ref0 = 0;
+  c->applied = 0;
+  c->next = 0;
+
+  if(rtc2_mem_read_byte(RTC2_CALIB_OFFSET + 4) == RTC2_CALIB_CHECK(lo, hi))
+    c->drift = (int16_t)(lo | ((uint16_t)hi << 8));
+  else
+    c->drift = 0;
+}
+
+static void rtc2_calib_store(int16_t drift){
+  uint8_t lo = drift & 0xFF, hi = (uint16_t)drift >> 8;
+
+  rtc2_mem_write_byte(RTC2_CALIB_OFFSET, lo);
+  rtc2_mem_write_byte(RTC2_CALIB_OFFSET + 2, hi);
+  rtc2_mem_write_byte(RTC2_CALIB_OFFSET + 4, RTC2_CALIB_CHECK(lo, hi));
+}
+
+// shifts clock by delta seconds writing only seconds register. done
+// right after rollover so there's almost a second to finish. refuses
+// if that would need carry into minutes even after waiting one more
+// second.
+static uint8_t rtc2_calib_nudge(int8_t delta){
+  int8_t sec = rtc2_wait_second_edge();
+
+  if(sec + delta < 0 || sec + delta > 59)
+    sec = rtc2_wait_second_edge();
+
+  if(sec == (int8_t)RTC2_SYNC_TIMEOUT || sec + delta < 0 || sec + delta > 59)
+    return 0;
+
+  rtc2_set_val(RTC2_SECONDS_WRITE, sec + delta);
+  return 1;
+}
+
+// seconds of clock time for one second of drift
+static uint32_t rtc2_calib_period(int16_t drift){
+  if(drift < 0)
+    drift = -drift;
+
+  return 16000000UL / (uint16_t)drift;
+}
+
+// removes err seconds from clock: nudges small errors, presets big ones
+static void rtc2_calib_correct(int32_t err){
+  rtc2_datetime_t tmp;
+
+  if(err <= RTC2_CALIB_MAX_ERROR && err >= -RTC2_CALIB_MAX_ERROR && rtc2_calib_nudge(-err))
+    return;
+
+  // refused nudge has waited a second or two, so reference is stale
+  // by now. clock is still err seconds off though.
+  rtc2_update(&tmp);
+  rtc2_localtime(&tmp, rtc2_timestamp(&tmp) - err);
+  rtc2_preset(&tmp);
+}
+
+void rtc2_calib_reference(rtc2_calib_t *c, uint32_t ref){
+  rtc2_datetime_t tmp;
+  int32_t err;
+
+  rtc2_update(&tmp);
+  err = (int32_t)(rtc2_timestamp(&tmp) - ref);
+
+  if(!c->ref0){
+    // first sync starts baseline
+    c->ref0 = ref;
+    c->applied = 0;
+  }else{
+    uint32_t elapsed = ref - c->ref0;
+
+    // error without our corrections is what crystal did since
+    // baseline start. longer baseline - better estimate.
+    if(elapsed >= RTC2_CALIB_MIN_BASELINE){
+      int32_t drift = (int64_t)(err - c->applied) * 16000000L / (int32_t)elapsed;
+
+      if(drift > INT16_MAX)
+        drift = INT16_MAX;
+      else if(drift < -INT16_MAX)
+        drift = -INT16_MAX;
+
+      if(drift != c->drift){
+        c->drift = drift;
+        rtc2_calib_store(c->drift);
+      }
+    }
+
+    c->applied -= err;
+  }
+
+  if(err)
+    rtc2_calib_correct(err);
+
+  // clock is right now, first nudge is due at half a second of drift
+  c->next = c->drift ? ref + rtc2_calib_period(c->drift) / 2 : 0;
+}
+
+uint8_t rtc2_calib_poll(rtc2_calib_t *c, uint32_t now){
+  int8_t delta = c->drift > 0 ? -1 : 1;
+
+  if(!c->next || (int32_t)(now - c->next) < 0)
+    return 0;
+
+  // near minute rollover, try again on next call
+  if(!rtc2_calib_nudge(delta))
+    return 0;
+
+  c->applied += delta;
+  c->next += rtc2_calib_period(c->drift);
+
+  return 1;
+}
+
+#endif
+// }}}
+
+// Event ring log {{{
+#if RTC2_LOG
+
+#define RTC2_LOG_HEADER 6
+#define RTC2_LOG_RECORD 3
+#define RTC2_LOG_BYTES (2 * RTC2_LOG_HEADER + RTC2_LOG_SLOTS * RTC2_LOG_RECORD)
+
+// whole log is recovered with one rtc2_mem_read from offset 0,
+// which takes at most 30 bytes
+#if RTC2_LOG_SLOTS < 3 || RTC2_LOG_BYTES > 30
+#error "RTC2_LOG_SLOTS must be within 3..6"
+#endif
+
+#if RTC2_CALIB && RTC2_LOG_BYTES * 2 > RTC2_CALIB_OFFSET
+#error "RTC2_LOG_SLOTS overlaps RTC2_CALIB_OFFSET"
+#endif
+
+#if RTC2_HEALTH_CANARY && RTC2_LOG_BYTES * 2 > RTC2_HEALTH_CANARY_OFFSET
+#error "RTC2_LOG_SLOTS overlaps RTC2_HEALTH_CANARY_OFFSET"
+#endif
+
+// RAM offset of record slot, as in RAM functions
+#define RTC2_LOG_SLOT_OFFSET(slot) ((2 * RTC2_LOG_HEADER + (slot) * RTC2_LOG_RECORD) * 2)
+
+// header: state (count << 4 | head), newest record time (LE), CRC8
+#define RTC2_LOG_HEAD(h) ((h)[0] & 0x0F)
+#define RTC2_LOG_COUNT(h) ((h)[0] >> 4)
+
+// Dallas/Maxim CRC8, same as 1-Wire devices use
+static uint8_t rtc2_crc8(const uint8_t *p, uint8_t size){
+  uint8_t crc = 0, i;
+
+  for(; size > 0; --size, ++p){
+    crc ^= *p;
+
+    for(i = 0; i < 8; ++i)
+      crc = crc & 1 ? (crc >> 1) ^ 0x8C : crc >> 1;
+  }
+
+  return crc;
+}
+
+static uint32_t rtc2_log_base(const uint8_t *h){
+  return h[1] | ((uint16_t)h[2] << 8) | ((uint32_t)h[3] << 16) | ((uint32_t)h[4] << 24);
+}
+
+static void rtc2_log_encode(uint8_t *h, uint8_t head, uint8_t count, uint32_t base){
+  h[0] = (count << 4) | head;
+  h[1] = base;
+  h[2] = base >> 8;
+  h[3] = base >> 16;
+  h[4] = base >> 24;
+  h[5] = rtc2_crc8(h, RTC2_LOG_HEADER - 1);
+}
+
+static uint8_t rtc2_log_valid(const uint8_t *h){
+  return rtc2_crc8(h, RTC2_LOG_HEADER - 1) == h[RTC2_LOG_HEADER - 1]
+      && RTC2_LOG_HEAD(h) < RTC2_LOG_SLOTS && RTC2_LOG_COUNT(h) < RTC2_LOG_SLOTS;
+}
+
+void rtc2_log_clear(rtc2_log_t *log){
+  rtc2_log_encode(log->header, 0, 0, 0);
+  rtc2_log_encode(log->header + RTC2_LOG_HEADER, 0, 0, 0);
+  log->newest = 0;
+
+  rtc2_mem_write(0, sizeof(log->header), log->header);
+}
+
+uint8_t rtc2_log_init(rtc2_log_t *log, rtc2_log_entry_t *entries){
+  uint8_t buf[RTC2_LOG_BYTES], *h, *rec, head, count, i;
+  uint32_t time;
+
+  rtc2_mem_read(0, sizeof(buf), buf);
+
+  // copy written by last append is the one whose head is one further.
+  // if it was torn by power loss the other one is still fine.
+  if(rtc2_log_valid(buf + RTC2_LOG_HEADER) && (!rtc2_log_valid(buf)
+        || RTC2_LOG_HEAD(buf + RTC2_LOG_HEADER) == (RTC2_LOG_HEAD(buf) + 1) % RTC2_LOG_SLOTS))
+    log->newest = 1;
+  else if(rtc2_log_valid(buf))
+    log->newest = 0;
+  else{
+    rtc2_log_clear(log);
+    return 0;
+  }
+
+  memcpy(log->header, buf, sizeof(log->header));
+
+  h = log->header + log->newest * RTC2_LOG_HEADER;
+  head = RTC2_LOG_HEAD(h);
+  count = RTC2_LOG_COUNT(h);
+
+  if(entries){
+    time = rtc2_log_base(h);
+
+    // walk back from newest record, deltas lead to older ones
+    for(i = count; i > 0; --i){
+      rec = buf + 2 * RTC2_LOG_HEADER + head * RTC2_LOG_RECORD;
+
+      entries[i - 1].time = time;
+      entries[i - 1].code = rec[2];
+
+      time -= rec[0] | ((uint16_t)rec[1] << 8);
+      head = head ? head - 1 : RTC2_LOG_SLOTS - 1;
+    }
+  }
+
+  return count;
+}
+
+void rtc2_log_append(rtc2_log_t *log, uint32_t time, uint8_t code){
+  uint8_t *h = log->header + log->newest * RTC2_LOG_HEADER, rec[RTC2_LOG_RECORD];
+  uint8_t head = RTC2_LOG_HEAD(h), count = RTC2_LOG_COUNT(h);
+  uint32_t delta = time - rtc2_log_base(h);
+
+  if(!count)
+    delta = 0;
+  else if(delta > 0xFFFF)
+    delta = 0xFFFF;
+
+  rec[0] = delta;
+  rec[1] = delta >> 8;
+  rec[2] = code;
+
+  // one slot is always spare, so record written here is outside
+  // of the newest header's view until the new one is committed
+  head = (head + 1) % RTC2_LOG_SLOTS;
+  rtc2_mem_write(RTC2_LOG_SLOT_OFFSET(head), sizeof(rec), rec);
+
+  if(count < RTC2_LOG_SLOTS - 1)
+    ++count;
+
+  // commit: replace older header copy. burst always starts from
+  // the first RAM byte, so the newest copy is rewritten as is.
+  log->newest ^= 1;
+  rtc2_log_encode(log->header + log->newest * RTC2_LOG_HEADER, head, count, time);
+  rtc2_mem_write(0, sizeof(log->header), log->header);
+}
+
+#endif
+// }}}
+
+// Delta encoded sampler {{{
+#if RTC2_SAMPLER
+
+void rtc2_sampler_init(rtc2_sampler_t *s, uint8_t *buf, uint8_t size){
+  s->buf = buf;
+  s->size = size;
+  s->head = s->len = 0;
+  s->last = 0;
+  s->dropped = 0;
+
+  rtc2_sampler_resync(s);
+}
+
+void rtc2_sampler_resync(rtc2_sampler_t *s){
+  // no seconds value is above 59, so next reading won't trust minute
+  s->seconds = 0xFF;
+}
+
+// seconds only read is trusted for hints below this. leaves 10 seconds
+// for MCU timer error and late calls
+#define RTC2_SAMPLER_TRUST_MS 50000
+
+uint8_t rtc2_sample(rtc2_sampler_t *s, uint16_t elapsed_ms){
+  rtc2_datetime_t now;
+  uint8_t tmp[5], size = 0, i;
+  uint32_t ts, val;
+
+  // seconds only read is 2 bytes on the bus instead of 8
+  rtc2_get(&now, RTC2_SECONDS_FIELD);
+
+  // seconds going down is minute rollover, but after a minute or
+  // more they may go up as well, only caller knows that
+  if(s->seconds > now.seconds || elapsed_ms >= RTC2_SAMPLER_TRUST_MS){
+    rtc2_update(&now);
+    s->minute = rtc2_timestamp(&now) - now.seconds;
+  }
+
+  s->seconds = now.seconds;
+  ts = s->minute + now.seconds;
+
+  // first sample goes as is, the rest as zigzag deltas
+  if(!s->last)
+    val = ts - RTC2_BASE_TIMESTAMP;
+  else if((int32_t)(ts - s->last) < 0)
+    val = ((s->last - ts) << 1) - 1;
+  else
+    val = (ts - s->last) << 1;
+
+  do{
+    tmp[size++] = (val & 0x7F) | (val > 0x7F ? 0x80 : 0);
+    val >>= 7;
+  }while(val);
+
+  if(s->size - s->len < size){
+    ++s->dropped;
+    return 0;
+  }
+
+  for(i = 0; i < size; ++i, ++s->len)
+    s->buf[(s->head + s->len) % s->size] = tmp[i];
+
+  s->last = ts;
+  return 1;
+}
+
+uint8_t rtc2_sampler_pop(rtc2_sampler_t *s, uint8_t *byte){
+  if(!s->len)
+    return 0;
+
+  *byte = s->buf[s->head];
+
+  if(++s->head == s->size)
+    s->head = 0;
+
+  --s->len;
+  return 1;
+}
+
+#endif
+// }}}
@@ -6,6 +6,10 @@
 #include <stddef.h>
 #include "rtc2_config.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 // Clock formats {{{
 #define RTC2_FORMAT_AM 0x80
 #define RTC2_FORMAT_PM 0xA0
@@ -90,6 +94,56 @@ void rtc2_update(rtc2_datetime dst);
 // as rtc2_update.
 void rtc2_get(rtc2_datetime dst, uint8_t fields);
 
+// Second boundary synchronization {{{
+#if RTC2_SYNC
+#define RTC2_SYNC_TIMEOUT 0xFF
+
+// polls only seconds register until it changes and returns new
+// seconds value, so following reads happen right after rollover.
+// gives up after 1.1 s worth of poll intervals, plus the time of
+// reads themselves (halted clock), and returns RTC2_SYNC_TIMEOUT.
+uint8_t rtc2_wait_second_edge(void);
+
+#if RTC2_SYNC_TRACK
+// Phase tracker: remembers MCU time (RTC2_SYNC_TIME ticks) of the last
+// rollover and measured MCU ticks per RTC second. rtc2_sync_next tells
+// when the next rollover is due, so program sleeps or does other work
+// until then and calls rtc2_sync_wait, which finds the edge with a few
+// reads:
+//
+//   uint32_t next = rtc2_sync_next(&sync);
+//
+//   while((int32_t)(RTC2_SYNC_TIME - next) < 0)
+//     do_other_work();
+//   rtc2_sync_wait(&sync);
+//
+// edge time is accurate to half of poll interval plus one read.
+typedef struct {
+  uint32_t edge;    // MCU time of last rollover
+  uint32_t period;  // MCU ticks per RTC second
+  uint8_t seconds;  // seconds value right after that rollover
+} rtc2_sync_t;
+
+// finds first edge (blocking, up to a second). returns seconds
+// value or RTC2_SYNC_TIMEOUT
+uint8_t rtc2_sync_init(rtc2_sync_t *sync);
+// MCU time to start polling for the next rollover after now:
+// RTC2_SYNC_GUARD ticks before it is predicted
+uint32_t rtc2_sync_next(const rtc2_sync_t *sync);
+// polls for next rollover right away, updates edge and period. called
+// before rtc2_sync_next it just polls longer (blocking up to a second).
+// returns seconds value or RTC2_SYNC_TIMEOUT. period is re-estimated
+// from seconds actually counted, so even large MCU timer error (RC
+// oscillator) is corrected after one call. calls must come less than
+// 2^31 ticks apart (35 minutes at 1MHz, 24 days with ms ticks).
+uint8_t rtc2_sync_wait(rtc2_sync_t *sync);
+
+// default RTC2_SYNC_TIME source, program has to define it
+uint32_t rtc2_sync_ticks(void);
+#endif
+#endif
+// }}}
+
 // Timestamp conversion functions {{{
 #if RTC2_TIMESTAMP
 // **WARNING1**: IT IS IN LOCAL TIMEZONE
@@ -106,6 +160,51 @@ uint32_t rtc2_timestamp(rtc2_datetime src);
 // populates rtc2_datetime from timestamp
 // will return 0 if timestamp is < RTC2_BASE_TIMESTAMP which is 1st January 2000
 uint8_t rtc2_localtime(rtc2_datetime dst, uint32_t timestamp);
+
+// Timezone conversion {{{
+#if RTC2_TZ
+// Zones are described POSIX TZ style and are meant to live in PROGMEM.
+// Timestamps are the same as above: "UTC" ones are real UNIX time,
+// "local" ones are what rtc2_mktime/rtc2_localtime work with.
+//
+// DST transition rule, POSIX "Mm.w.d/time"
+typedef struct {
+  uint8_t month;   // 1..12
+  uint8_t week;    // 1..5, 5 is the last week of month
+  uint8_t wday;    // 0 is Sunday
+  int16_t minutes; // time of transition, minutes since local midnight
+} rtc2_tz_rule_t;
+
+// offsets are minutes *east* of UTC, that is the opposite sign of POSIX
+// TZ. zone without DST has dst_offset equal to std_offset.
+// for example "CET-1CEST,M3.5.0,M10.5.0/3" is
+//
+//   const rtc2_tz_t cet PROGMEM = {60, 120, {3, 5, 0, 120}, {10, 5, 0, 180}};
+typedef struct {
+  int16_t std_offset;
+  int16_t dst_offset;
+  rtc2_tz_rule_t start; // in local standard time
+  rtc2_tz_rule_t end;   // in local daylight time
+} rtc2_tz_t;
+
+// UTC range of a year the transitions are calculated for. conversion
+// within this range is just two comparisons, new year recalculates.
+typedef struct {
+  const rtc2_tz_t *tz;
+  uint32_t from, to;
+  uint32_t start, end; // DST start/end, UTC
+  int32_t std, dst;    // offsets in seconds
+} rtc2_tz_cache_t;
+
+// tz must point to PROGMEM
+void rtc2_tz_init(rtc2_tz_cache_t *cache, const rtc2_tz_t *tz);
+uint32_t rtc2_utc_to_local(rtc2_tz_cache_t *cache, uint32_t utc);
+// skipped hour at DST start is taken as standard time,
+// repeated hour at DST end as daylight time
+uint32_t rtc2_local_to_utc(rtc2_tz_cache_t *cache, uint32_t local);
+#endif
+// }}}
+
 #endif
 //}}}
 
@@ -132,6 +231,30 @@ uint8_t rtc2_mem_read_byte(uint8_t offset);
 void rtc2_mem_write(uint8_t offset, size_t size, const void *src);
 void rtc2_mem_read(uint8_t offset, size_t size, void *dst);
 
+/// RAM streaming {{{
+#if RTC2_RAM_STREAM
+// same as rtc2_mem_read/rtc2_mem_write, but bytes are passed one by one
+// to/from a callback instead of a caller buffer, so forwarding RAM
+// somewhere (USART, checksum, ...) doesn't need a staging buffer.
+// ctx is passed to the callback as is.
+//
+// unlike those two the last byte is checked at offset + (size - 1) * 2,
+// so the whole RAM (offset 0, size 31) can be streamed in one call.
+//
+// rtc2_mem_stream uses burst mode also for non-zero offsets by skipping
+// leading bytes when that is cheaper than reading bytes one by one.
+//
+// SRAM saved on AVR has not been measured. `make stack_usage` reports
+// host (x86-64) frames, which say nothing about AVR stack use; `make
+// avr_stack_usage` gives avr-gcc -fstack-usage numbers for rtc2.c.
+typedef void (*rtc2_mem_sink)(uint8_t value, void *ctx);
+typedef uint8_t (*rtc2_mem_source)(void *ctx);
+
+void rtc2_mem_stream(uint8_t offset, size_t size, rtc2_mem_sink sink, void *ctx);
+void rtc2_mem_fill(uint8_t offset, size_t size, rtc2_mem_source source, void *ctx);
+#endif
+// }}}
+
 /// RAM string helpers {{{
 #if RTC2_RAM_STRINGS
 void rtc2_mem_puts(uint8_t offset, const char *src);
@@ -164,10 +287,201 @@ void rtc2_set_protection(uint8_t true_false);
 #endif
 // }}}
 
+// Bus health checks {{{
+#if RTC2_HEALTH
+
+// Missing or unpowered DS1302 or stuck I/O line make plain functions
+// return 0x00/0xFF garbage. Checked variants below probe the bus first,
+// validate what they've read and return one of these codes.
+#define RTC2_OK          0
+#define RTC2_ERR_BUS     1 // probe failed: no chip or stuck line
+#define RTC2_ERR_RANGE   2 // clock field is not BCD or out of range
+#define RTC2_ERR_BACKOFF 3 // bus was failing recently, call skipped
+#define RTC2_ERR_ARGS    4 // offset/size don't fit into RAM
+
+// After a failure next calls are skipped (without touching the bus)
+// for 1, 2, 4, ... up to RTC2_HEALTH_MAX_BACKOFF calls, so time spent
+// on a dead bus is bounded by a single probe per call at most.
+// Successful probe resets the backoff.
+
+// cheap presence check: WP register must read as 0x00 or 0x80,
+// plus RAM canary if RTC2_HEALTH_CANARY is enabled.
+// does not honor backoff.
+uint8_t rtc2_probe(void);
+
+#if RTC2_HEALTH_CANARY && RTC2_RAM
+// writes canary value into reserved RAM byte. call once after rtc2_init
+// (and after clearing write protection if it's set)
+void rtc2_health_init(void);
+#endif
+
+#if RTC2_READ
+// rtc2_get with probe, BCD digit check and range check of fields
+uint8_t rtc2_get_checked(rtc2_datetime dst, uint8_t fields);
+#endif
+
+#if RTC2_RAM
+// rtc2_mem_read with probe and argument check
+uint8_t rtc2_mem_read_checked(uint8_t offset, size_t size, void *dst);
+#endif
+
+#endif
+// }}}
+
+// Drift calibration {{{
+#if RTC2_CALIB
+
+// Instead of presetting whole clock on every resync, calibration
+// estimates crystal drift from (reference, clock) pairs, keeps it in
+// DS1302 RAM and corrects the clock by rewriting just the seconds
+// register, one second at a time, when accumulated drift predicts
+// half a second of error. Between references error then only grows
+// with the drift estimate's own error: after a week of daily
+// references both clocks' 1 second resolution leaves about 1.7 ppm,
+// and host check measures up to 2 seconds over the following two
+// weeks (a crystal left alone drifts tens of seconds meanwhile).
+typedef struct {
+  uint32_t ref0;   // reference time of first sync, 0 if none
+  int32_t applied; // seconds nudged since then
+  uint32_t next;   // clock time of next nudge, 0 if none planned
+  int16_t drift;   // 1/16 ppm, positive when DS1302 runs fast
+} rtc2_calib_t;
+
+// loads drift coefficient from RAM (0 if there's none)
+void rtc2_calib_init(rtc2_calib_t *calib);
+// feeds reference UNIX time (e.g. from NTP/GPS). refines drift,
+// corrects clock and plans next nudge. error above
+// RTC2_CALIB_MAX_ERROR is corrected with full preset. blocks like
+// rtc2_calib_poll when clock has to be nudged.
+void rtc2_calib_reference(rtc2_calib_t *calib, uint32_t ref);
+// call periodically with current clock timestamp. nudges seconds
+// register when it's time, returns 1 if it did. waits for seconds
+// rollover and, when that rollover is too close to minute carry, for
+// one more, so it may block for over 2 seconds (two
+// rtc2_wait_second_edge calls).
+uint8_t rtc2_calib_poll(rtc2_calib_t *calib, uint32_t now);
+
+#endif
+// }}}
+
+// Event ring log {{{
+#if RTC2_LOG
+
+// Keeps last RTC2_LOG_SLOTS - 1 events (power fail, reset, ...) in
+// battery backed RAM. Every record is 16 bit time delta to previous
+// record and event code, header keeps newest record time, head index,
+// count and CRC8. Header is stored twice and the older copy is replaced
+// on append, so append costs 3 single byte writes plus one 12 byte
+// burst, always. Power loss at any point of append leaves either old
+// or new log, never a broken one.
+typedef struct {
+  uint32_t time;
+  uint8_t code;
+} rtc2_log_entry_t;
+
+// MCU side mirror of both headers
+typedef struct {
+  uint8_t header[12];
+  uint8_t newest;
+} rtc2_log_t;
+
+// recovers log with one burst read. if entries isn't NULL it receives
+// records oldest first, it must have room for RTC2_LOG_SLOTS - 1 of
+// them. returns number of records. broken log is cleared.
+uint8_t rtc2_log_init(rtc2_log_t *log, rtc2_log_entry_t *entries);
+// time is UNIX timestamp, records further than 18 hours apart
+// store saturated delta
+void rtc2_log_append(rtc2_log_t *log, uint32_t time, uint8_t code);
+void rtc2_log_clear(rtc2_log_t *log);
+
+#endif
+// }}}
+
+// Delta encoded sampler {{{
+#if RTC2_SAMPLER
+
+// Stores clock samples into caller's byte ring buffer as varints:
+// first sample is seconds since RTC2_BASE_TIMESTAMP, every next one is
+// zigzag encoded delta to the previous stored sample, so sampling
+// faster than once a second costs one byte per sample.
+// tools/rtc2_samples decodes the stream back into timestamps.
+//
+// Only seconds register is read while seconds go up, full burst read
+// happens on minute rollover. Seconds alone can't tell a minute or more
+// passed, so rtc2_sample takes time since previous call as a hint:
+// hints of 50 s and more (or RTC2_SAMPLER_UNKNOWN) force full read.
+#define RTC2_SAMPLER_UNKNOWN 0xFFFF
+
+typedef struct {
+  uint8_t *buf;
+  uint8_t size, head, len;
+  uint8_t seconds;   // seconds of last reading
+  uint32_t minute;   // timestamp of last reading minus its seconds
+  uint32_t last;     // last stored timestamp, 0 if none yet
+  uint16_t dropped;  // samples not stored because buffer was full
+} rtc2_sampler_t;
+
+void rtc2_sampler_init(rtc2_sampler_t *sampler, uint8_t *buf, uint8_t size);
+// forces full read on next sample
+void rtc2_sampler_resync(rtc2_sampler_t *sampler);
+// reads clock and stores sample. elapsed_ms is MCU time since previous
+// call, e.g. from millis counter, saturated to RTC2_SAMPLER_UNKNOWN.
+// returns 0 if buffer is full (sample is dropped and counted, stream
+// stays decodable)
+uint8_t rtc2_sample(rtc2_sampler_t *sampler, uint16_t elapsed_ms);
+// takes oldest byte out of buffer, returns 0 if it's empty
+uint8_t rtc2_sampler_pop(rtc2_sampler_t *sampler, uint8_t *byte);
+
+#endif
+// }}}
+
+// Bus trace {{{
+#if RTC2_TRACE
+
+// Debug mode: every CE/SCLK/IO change made by the driver and every
+// IO sample is logged with RTC2_TRACE_TIME timestamp into a ring
+// buffer of RTC2_TRACE_SIZE entries. Timestamp is taken right before
+// the pin access. Logging runs after it and stretches every interval
+// by its own run time, rtc2_trace_overhead ticks per entry, so raw
+// trace shows slower bus than a normal build and hides violations.
+//
+// To analyze, dump "C <rtc2_trace_overhead()>" line and entries as
+// "T <time> <flags in hex>" lines (e.g. over USART) and feed them to
+// tools/rtc2_vcd. It subtracts the overhead and writes VCD file and
+// timing report against datasheet limits.
+
+// pin state after the change, IO is a line level
+#define RTC2_TRACE_CE     0x01
+#define RTC2_TRACE_CLK    0x02
+#define RTC2_TRACE_IO     0x04
+#define RTC2_TRACE_IO_OUT 0x08 // IO driven by MCU
+#define RTC2_TRACE_SAMPLE 0x10 // MCU read IO line
+
+typedef struct {
+  uint16_t time;
+  uint8_t flags;
+} rtc2_trace_entry_t;
+
+// number of logged entries
+uint8_t rtc2_trace_count(void);
+// i-th entry, oldest first, NULL if i is out of range
+const rtc2_trace_entry_t *rtc2_trace_get(uint8_t i);
+// empties buffer and measures logging overhead. rtc2_init calls it.
+void rtc2_trace_clear(void);
+// ticks one entry adds to bus timing, as measured by rtc2_trace_clear
+uint16_t rtc2_trace_overhead(void);
+
+#endif
+// }}}
+
 // Default global variable (actually initialized pointer) {{{
 #if RTC2_DEFAULT && (RTC2_READ || RTC2_WRITE)
-volatile rtc2_datetime RTC2_VALUE;
+extern volatile rtc2_datetime RTC2_VALUE;
 #endif
 // }}}
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif
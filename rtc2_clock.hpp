@@ -0,0 +1,223 @@
+// vim: foldmethod=marker
+#ifndef __RTC2_CLOCK_HPP__
+#define __RTC2_CLOCK_HPP__
+
+// C++ clock adapter: ds1302_clock meets standard Clock requirements
+// (rep, period, duration, time_point, is_steady, now()), so DS1302
+// time can be used with std::chrono arithmetic. Time points are plain
+// seconds counters, calendar decomposition happens only in
+// to_datetime.
+//
+// Epoch is RTC2_BASE_TIMESTAMP (1st January 2000) and rep is 32 bit
+// signed, so time points cover 2000..2068 and are cheap on AVR.
+//
+// Where <chrono> is missing (avr-libc has no C++ library) minimal
+// stand-ins for duration/time_point with the same interface are used.
+// Their constructors are constexpr, so clock state below is constant
+// initialized and needs no __cxa_guard_* (avr-libc has none either).
+// Either way C++11 is required.
+
+#include "rtc2.h"
+
+#if !(RTC2_READ && RTC2_TIMESTAMP)
+#error "ds1302_clock needs RTC2_READ and RTC2_TIMESTAMP"
+#endif
+
+#if !defined(RTC2_HAVE_CHRONO) && defined(__has_include)
+#if __has_include(<chrono>)
+#define RTC2_HAVE_CHRONO 1
+#endif
+#endif
+
+#ifndef RTC2_HAVE_CHRONO
+#define RTC2_HAVE_CHRONO 0
+#endif
+
+#if RTC2_HAVE_CHRONO
+#include <chrono>
+#include <ratio>
+#endif
+
+namespace rtc2 {
+
+// Minimal chrono stand-ins {{{
+#if RTC2_HAVE_CHRONO
+
+template <class Rep, class Period>
+using duration = std::chrono::duration<Rep, Period>;
+
+template <class Clock, class Duration>
+using time_point = std::chrono::time_point<Clock, Duration>;
+
+typedef std::ratio<1> ratio_1;
+
+#else
+
+struct ratio_1 {
+  static const long num = 1;
+  static const long den = 1;
+};
+
+template <class Rep, class Period>
+class duration {
+public:
+  typedef Rep rep;
+  typedef Period period;
+
+  constexpr duration() : r(0) {}
+  constexpr explicit duration(rep v) : r(v) {}
+
+  constexpr rep count() const{ return r; }
+
+  duration operator-() const{ return duration(-r); }
+  duration &operator+=(const duration &d) { r += d.r; return *this; }
+  duration &operator-=(const duration &d) { r -= d.r; return *this; }
+
+  friend duration operator+(duration a, const duration &b) { return a += b; }
+  friend duration operator-(duration a, const duration &b) { return a -= b; }
+  friend bool operator==(const duration &a, const duration &b) { return a.r == b.r; }
+  friend bool operator!=(const duration &a, const duration &b) { return a.r != b.r; }
+  friend bool operator<(const duration &a, const duration &b) { return a.r < b.r; }
+  friend bool operator>(const duration &a, const duration &b) { return a.r > b.r; }
+  friend bool operator<=(const duration &a, const duration &b) { return a.r <= b.r; }
+  friend bool operator>=(const duration &a, const duration &b) { return a.r >= b.r; }
+
+private:
+  rep r;
+};
+
+template <class Clock, class Duration>
+class time_point {
+public:
+  typedef Clock clock;
+  typedef Duration duration;
+
+  constexpr time_point() : d() {}
+  constexpr explicit time_point(const duration &v) : d(v) {}
+
+  constexpr duration time_since_epoch() const{ return d; }
+
+  time_point &operator+=(const duration &v) { d += v; return *this; }
+  time_point &operator-=(const duration &v) { d -= v; return *this; }
+
+  friend time_point operator+(time_point a, const duration &b) { return a += b; }
+  friend time_point operator-(time_point a, const duration &b) { return a -= b; }
+  friend duration operator-(const time_point &a, const time_point &b) { return a.d - b.d; }
+  friend bool operator==(const time_point &a, const time_point &b) { return a.d == b.d; }
+  friend bool operator!=(const time_point &a, const time_point &b) { return a.d != b.d; }
+  friend bool operator<(const time_point &a, const time_point &b) { return a.d < b.d; }
+  friend bool operator>(const time_point &a, const time_point &b) { return a.d > b.d; }
+  friend bool operator<=(const time_point &a, const time_point &b) { return a.d <= b.d; }
+  friend bool operator>=(const time_point &a, const time_point &b) { return a.d >= b.d; }
+
+private:
+  duration d;
+};
+
+#endif
+// }}}
+
+// DS1302 clock {{{
+struct ds1302_clock {
+  typedef int32_t rep;
+  typedef ratio_1 period;
+  typedef rtc2::duration<rep, period> duration;
+  typedef rtc2::time_point<ds1302_clock, duration> time_point;
+
+  // clock can be preset at any moment
+  static const bool is_steady = false;
+
+  // milliseconds counter used to decide whether cached time point
+  // is still fresh. without it every now() reads the chip.
+  typedef uint32_t (*ticks_fn)(void);
+
+  // now() reads DS1302 at most once per refresh_ms and extrapolates
+  // cached value by elapsed whole seconds in between
+  static void set_ticks(ticks_fn fn, uint16_t refresh_ms = 1000){
+    state &s = get_state();
+    s.ticks = fn;
+    s.refresh_ms = refresh_ms;
+    s.valid = false;
+  }
+
+  // forces next now() to read the chip, e.g. after rtc2_preset
+  static void invalidate(){
+    get_state().valid = false;
+  }
+
+  static time_point now(){
+    state &s = get_state();
+    uint32_t t = 0, elapsed;
+
+    if(s.ticks){
+      t = s.ticks();
+      elapsed = t - s.read_at;
+
+      if(s.valid && elapsed < s.refresh_ms)
+        return s.last + duration(static_cast<rep>(elapsed / 1000));
+    }
+
+    rtc2_datetime_t tmp;
+    rtc2_update(&tmp);
+
+    s.last = from_datetime(&tmp);
+    s.read_at = t;
+    s.valid = s.ticks != 0;
+
+    return s.last;
+  }
+
+  // conversion from/to DS1302 register values
+  static time_point from_datetime(rtc2_datetime src){
+    return time_point(duration(static_cast<rep>(rtc2_timestamp(src) - RTC2_BASE_TIMESTAMP)));
+  }
+
+  // returns 0 for time points before 1st January 2000
+  static uint8_t to_datetime(const time_point &tp, rtc2_datetime dst){
+    return rtc2_localtime(dst, to_time_t(tp));
+  }
+
+  // UNIX timestamp, same as rtc2_timestamp
+  static uint32_t to_time_t(const time_point &tp){
+    return static_cast<uint32_t>(tp.time_since_epoch().count()) + RTC2_BASE_TIMESTAMP;
+  }
+
+  static time_point from_time_t(uint32_t t){
+    return time_point(duration(static_cast<rep>(t - RTC2_BASE_TIMESTAMP)));
+  }
+
+#if RTC2_HAVE_CHRONO
+  // same as C++20 std::chrono::sys_seconds
+  typedef std::chrono::time_point<std::chrono::system_clock, std::chrono::seconds> sys_seconds;
+
+  static sys_seconds to_sys(const time_point &tp){
+    return sys_seconds(std::chrono::seconds(
+          static_cast<std::chrono::seconds::rep>(tp.time_since_epoch().count()) + RTC2_BASE_TIMESTAMP));
+  }
+
+  static time_point from_sys(const sys_seconds &tp){
+    return time_point(duration(static_cast<rep>(tp.time_since_epoch().count() - RTC2_BASE_TIMESTAMP)));
+  }
+#endif
+
+private:
+  struct state {
+    ticks_fn ticks;
+    uint16_t refresh_ms;
+    uint32_t read_at;
+    bool valid;
+    time_point last;
+  };
+
+  // function local static keeps this header-only without C++17.
+  // initializer is a constant expression, so there is no init guard
+  static state &get_state(){
+    static state s = {0, 1000, 0, false, time_point()};
+    return s;
+  }
+};
+// }}}
+
+}
+
+#endif
@@ -43,6 +43,12 @@
 #define RTC2_TIMESTAMP 1
 #endif
 
+// enable UTC <-> local time conversion with DST rules.
+// RTC2_TIMESTAMP must be enabled to use this.
+#ifndef RTC2_TZ
+#define RTC2_TZ 0
+#endif
+
 // enable clock write functions?
 #ifndef RTC2_WRITE
 #define RTC2_WRITE 1
@@ -58,16 +64,140 @@
 #define RTC2_RAM 1
 #endif
 
+// RAM streaming functions (callback based read/write). RTC2_RAM must be
+// enabled to use this.
+#ifndef RTC2_RAM_STREAM
+#define RTC2_RAM_STREAM 1
+#endif
+
 // RAM strings functions puts/gets. RTC2_RAM must be enabled to use this.
 #ifndef RTC2_RAM_STRINGS
 #define RTC2_RAM_STRINGS 1
 #endif
 
+// enable second boundary wait (rtc2_wait_second_edge).
+// RTC2_READ must be enabled to use this.
+#ifndef RTC2_SYNC
+#define RTC2_SYNC 1
+#endif
+
+// seconds register poll interval while waiting for rollover, us
+#ifndef RTC2_SYNC_POLL_US
+#define RTC2_SYNC_POLL_US 100
+#endif
+
+// enable phase tracker (rtc2_sync_t). needs MCU timer, see below.
+#ifndef RTC2_SYNC_TRACK
+#define RTC2_SYNC_TRACK 0
+#endif
+
+// free running 32 bit MCU time source for phase tracker and its
+// nominal rate. by default program has to provide the function.
+#ifndef RTC2_SYNC_TIME
+#define RTC2_SYNC_TIME rtc2_sync_ticks()
+#endif
+
+#ifndef RTC2_SYNC_TICKS_PER_SECOND
+#define RTC2_SYNC_TICKS_PER_SECOND 1000000UL
+#endif
+
+// start polling this many ticks before predicted rollover. must cover
+// MCU timer vs crystal drift between two rtc2_sync_wait calls.
+#ifndef RTC2_SYNC_GUARD
+#define RTC2_SYNC_GUARD (RTC2_SYNC_TICKS_PER_SECOND / 500)
+#endif
+
 // enable utility functions: clock halt, charger and protection settings
 #ifndef RTC2_UTILITY
 #define RTC2_UTILITY 1
 #endif
 
+// enable bus health checks: presence probe, range checks, error codes
+// and backoff on dead bus. see rtc2.h for details.
+#ifndef RTC2_HEALTH
+#define RTC2_HEALTH 0
+#endif
+
+// maximum number of calls to skip after bus failure
+#ifndef RTC2_HEALTH_MAX_BACKOFF
+#define RTC2_HEALTH_MAX_BACKOFF 64
+#endif
+
+// also check RAM canary on probe? detects I/O stuck low which WP check
+// can't see. canary occupies one RAM byte at RTC2_HEALTH_CANARY_OFFSET
+// (offset as in RAM functions).
+#ifndef RTC2_HEALTH_CANARY
+#define RTC2_HEALTH_CANARY 0
+#endif
+
+#ifndef RTC2_HEALTH_CANARY_OFFSET
+#define RTC2_HEALTH_CANARY_OFFSET 60
+#endif
+
+#ifndef RTC2_HEALTH_CANARY_VALUE
+#define RTC2_HEALTH_CANARY_VALUE 0xA5
+#endif
+
+// enable drift calibration (rtc2_calib_t). needs RTC2_READ, RTC2_WRITE,
+// RTC2_TIMESTAMP, RTC2_RAM and RTC2_SYNC.
+#ifndef RTC2_CALIB
+#define RTC2_CALIB 0
+#endif
+
+// RAM offset (as in RAM functions) of 3 bytes keeping drift coefficient
+#ifndef RTC2_CALIB_OFFSET
+#define RTC2_CALIB_OFFSET 54
+#endif
+
+// reference error (seconds) above which clock is fully preset
+// instead of nudged
+#ifndef RTC2_CALIB_MAX_ERROR
+#define RTC2_CALIB_MAX_ERROR 5
+#endif
+
+// minimal time (seconds) since first sync before drift is estimated.
+// both clocks have 1 second resolution, so estimate is off by up to
+// 1000000 / baseline ppm: 46 ppm for 6 hours, 11.6 ppm for a day.
+#ifndef RTC2_CALIB_MIN_BASELINE
+#define RTC2_CALIB_MIN_BASELINE 86400
+#endif
+
+// enable event ring log kept in DS1302 RAM (rtc2_log_t).
+// needs RTC2_RAM and RTC2_BURST.
+#ifndef RTC2_LOG
+#define RTC2_LOG 0
+#endif
+
+// number of record slots, log keeps one less records. log occupies
+// 12 + 3 * RTC2_LOG_SLOTS bytes from the beginning of RAM, 3..6 slots.
+// default leaves last 4 bytes for calibration and canary.
+#ifndef RTC2_LOG_SLOTS
+#define RTC2_LOG_SLOTS 5
+#endif
+
+// enable delta encoded clock sampler (rtc2_sampler_t).
+// needs RTC2_READ and RTC2_TIMESTAMP.
+#ifndef RTC2_SAMPLER
+#define RTC2_SAMPLER 0
+#endif
+
+// debug mode: log bus edges into ring buffer. see rtc2.h for details.
+// do not enable in production, it slows down the bus.
+#ifndef RTC2_TRACE
+#define RTC2_TRACE 0
+#endif
+
+// number of logged entries (3 bytes each), at most 255
+#ifndef RTC2_TRACE_SIZE
+#define RTC2_TRACE_SIZE 64
+#endif
+
+// timestamp source, any free running 16 bit counter. Timer1 must
+// be started by program.
+#ifndef RTC2_TRACE_TIME
+#define RTC2_TRACE_TIME TCNT1
+#endif
+
 // a macro for getting available memory size. not used anywhere,
 // maybe can be used in program
 #define RTC2_MEM_SIZE ((RTC2_MEM_START - RTC2_MEM_END) / 2 + 1)
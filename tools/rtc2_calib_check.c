@@ -0,0 +1,122 @@
+// vim: foldmethod=marker
+// Host side check of drift calibration (RTC2_CALIB) against DS1302
+// simulator with crystal error: daily references for a week, then
+// two weeks of free running on nudges only.
+//
+// build: make rtc2_calib_check
+#include <stdio.h>
+
+#include "rtc2.h"
+#include "ds1302_sim.h"
+
+#if !RTC2_CALIB
+#error "build with RTC2_CALIB=1"
+#endif
+
+// Monday 19th October 2026, 10:15:30 UTC
+#define START 1792404930UL
+
+#define HOUR 3600e6
+#define REFERENCE_DAYS 7
+#define FREE_DAYS 14
+
+// true time, seconds
+static double true_now(void){
+  return START + ds1302_sim_time_us / 1e6;
+}
+
+// clock time including fraction of current second
+static double clock_now(void){
+  rtc2_datetime_t d;
+
+  rtc2_update(&d);
+  return rtc2_timestamp(&d) + ds1302_sim_phase_us() / 1e6;
+}
+
+static void set_clock(uint32_t t){
+  rtc2_datetime_t d;
+
+  rtc2_localtime(&d, t);
+  rtc2_preset(&d);
+}
+
+// Drift scenario {{{
+static void check_drift(double ppm){
+  double err, worst = 0;
+  rtc2_datetime_t d;
+  rtc2_calib_t c;
+  uint16_t hour, nudges = 0;
+
+  ds1302_sim_reset();
+  ds1302_sim_ppm = ppm;
+  rtc2_init();
+  set_clock(START);
+
+  rtc2_calib_init(&c);
+  ds1302_sim_expect(c.drift == 0, "fresh RAM gives drift %d", c.drift);
+
+  ds1302_sim_idle(300000);
+  rtc2_calib_reference(&c, (uint32_t)true_now());
+
+  for(hour = 1; hour <= (REFERENCE_DAYS + FREE_DAYS) * 24; ++hour){
+    ds1302_sim_idle(HOUR - 1000);
+
+    if(hour <= REFERENCE_DAYS * 24 && !(hour % 24))
+      rtc2_calib_reference(&c, (uint32_t)true_now());
+
+    rtc2_update(&d);
+    nudges += rtc2_calib_poll(&c, rtc2_timestamp(&d));
+
+    err = clock_now() - true_now();
+
+    if(hour > REFERENCE_DAYS * 24 && (err > worst || -err > worst))
+      worst = err < 0 ? -err : err;
+  }
+
+  printf("crystal %+6.1f ppm: estimated %+6.2f ppm, %u nudges, worst error %.2f s over %u days\n",
+      ppm, c.drift / 16.0, nudges, worst, FREE_DAYS);
+
+  // week of 1 second resolution references gives about 1.7 ppm,
+  // that is 2 seconds over two weeks, plus half a second of nudging
+  ds1302_sim_expect(worst < 2.5, "%+.1f ppm: worst error %.2f s", ppm, worst);
+
+  rtc2_calib_init(&c);
+  ds1302_sim_expect(c.drift && (c.drift > 0) == (ppm > 0), "%+.1f ppm: stored drift %d", ppm, c.drift);
+}
+// }}}
+
+// Preset fallback {{{
+// error within RTC2_CALIB_MAX_ERROR is nudged, but right before minute
+// rollover nudging back is refused even after waiting a second more.
+// the clock is preset then and must not lose the time spent waiting.
+static void check_fallback(void){
+  uint32_t ref;
+  rtc2_calib_t c;
+  double err, t0;
+
+  ds1302_sim_reset();
+  rtc2_init();
+  rtc2_calib_init(&c);
+
+  // clock is 3.5 s ahead and shows hh:mm:59.5
+  ref = START - START % 60 + 56;
+  set_clock(ref + 3);
+  ds1302_sim_idle(500000);
+
+  t0 = ds1302_sim_time_us;
+  rtc2_calib_reference(&c, ref);
+
+  err = clock_now() - (ref + 0.5 + (ds1302_sim_time_us - t0) / 1e6);
+  ds1302_sim_expect(err > -1 && err < 1, "preset fallback left %.2f s error", err);
+}
+// }}}
+
+int main(void){
+  check_drift(37);
+  check_drift(-23);
+  check_drift(100);
+  check_drift(-4);
+  check_fallback();
+
+  return ds1302_sim_report("rtc2_calib_check");
+}
@@ -0,0 +1,100 @@
+// vim: foldmethod=marker
+// Host side check of ds1302_clock (rtc2_clock.hpp) against DS1302
+// simulator. Built twice: with <chrono> (C++20) and with the fallback
+// stand-ins (C++11, RTC2_HAVE_CHRONO=0) that avr-g++ uses.
+//
+// build: make rtc2_clock_check rtc2_clock_check_nochrono
+#include <stdio.h>
+
+#include "rtc2_clock.hpp"
+#include "ds1302_sim.h"
+
+using rtc2::ds1302_clock;
+
+static uint32_t ms;
+
+static uint32_t ticks(void){
+  return ms;
+}
+
+int main(){
+  rtc2_datetime_t d = {};
+  double t;
+
+  ds1302_sim_reset();
+  rtc2_init();
+
+  // Monday 19th October 2026, 10:15:30
+  d.seconds = 30;
+  d.minutes = 15;
+  d.hours = 10;
+  d.date = 19;
+  d.month = 10;
+  d.year = 26;
+  d.wday = 1;
+  rtc2_preset(&d);
+
+  // Without ticks source every now() reads the chip {{{
+  ds1302_clock::time_point a = ds1302_clock::now();
+  ds1302_sim_expect(ds1302_clock::to_time_t(a) == 1792404930UL,
+      "now() is %lu", (unsigned long)ds1302_clock::to_time_t(a));
+
+  t = ds1302_sim_time_us;
+  ds1302_clock::now();
+  ds1302_sim_expect(ds1302_sim_time_us != t, "now() without ticks didn't read the chip");
+  // }}}
+
+  // Cached time point is extrapolated within refresh period {{{
+  ds1302_clock::set_ticks(ticks, 5000);
+  ds1302_clock::time_point b = ds1302_clock::now();
+
+  ms = 2500;
+  t = ds1302_sim_time_us;
+  ds1302_clock::time_point c = ds1302_clock::now();
+
+  ds1302_sim_expect(ds1302_sim_time_us == t, "cached now() touched the bus");
+  ds1302_sim_expect((c - b).count() == 2, "extrapolated by %ld s", (long)(c - b).count());
+
+  ms = 5000;
+  ds1302_clock::now();
+  ds1302_sim_expect(ds1302_sim_time_us != t, "now() after refresh period didn't read the chip");
+
+  ds1302_clock::invalidate();
+  t = ds1302_sim_time_us;
+  ds1302_clock::now();
+  ds1302_sim_expect(ds1302_sim_time_us != t, "now() after invalidate() didn't read the chip");
+  // }}}
+
+  // Conversions {{{
+  ds1302_sim_expect(ds1302_clock::to_datetime(c + ds1302_clock::duration(3600), &d) &&
+      d.hours == 11 && d.minutes == 15 && d.seconds == 32 && d.date == 19 && d.wday == 1,
+      "to_datetime gives %u:%u:%u %u/%u/%u", d.hours, d.minutes, d.seconds, d.date, d.month, d.year);
+
+  ds1302_sim_expect(ds1302_clock::from_datetime(&d) == c + ds1302_clock::duration(3600),
+      "from_datetime(to_datetime(tp)) != tp");
+
+  ds1302_sim_expect(ds1302_clock::from_time_t(RTC2_BASE_TIMESTAMP).time_since_epoch().count() == 0,
+      "epoch is not 1st January 2000");
+
+  ds1302_sim_expect(!ds1302_clock::to_datetime(ds1302_clock::time_point(ds1302_clock::duration(-1)), &d),
+      "time point before 2000 converted");
+  // }}}
+
+#if RTC2_HAVE_CHRONO
+  // std::chrono interoperability {{{
+  ds1302_clock::sys_seconds s = ds1302_clock::to_sys(a);
+
+  ds1302_sim_expect(s.time_since_epoch().count() == 1792404930LL, "to_sys gives %lld",
+      (long long)s.time_since_epoch().count());
+  ds1302_sim_expect(ds1302_clock::from_sys(s) == a, "from_sys(to_sys(tp)) != tp");
+  ds1302_sim_expect(std::chrono::duration_cast<std::chrono::minutes>(c + ds1302_clock::duration(3600) - a).count() == 60,
+      "duration_cast to minutes");
+
+#if __cplusplus >= 202002L
+  static_assert(std::chrono::is_clock<ds1302_clock>::value, "ds1302_clock must meet Clock requirements");
+#endif
+  // }}}
+#endif
+
+  return ds1302_sim_report(RTC2_HAVE_CHRONO ? "rtc2_clock_check" : "rtc2_clock_check_nochrono");
+}
@@ -0,0 +1,173 @@
+// vim: foldmethod=marker
+// Host side check of bus health layer (RTC2_HEALTH) against DS1302
+// simulator with injected I/O faults.
+//
+// build: make rtc2_health_check (compiles rtc2.c with RTC2_HEALTH and
+// RTC2_HEALTH_CANARY enabled, see Makefile)
+#include <stdio.h>
+
+#include "rtc2.h"
+#include "ds1302_sim.h"
+
+#if !(RTC2_HEALTH && RTC2_HEALTH_CANARY)
+#error "build with RTC2_HEALTH=1 and RTC2_HEALTH_CANARY=1"
+#endif
+
+static rtc2_datetime_t now;
+
+static uint16_t skipped_calls(uint8_t *ret);
+
+static void setup(void){
+  rtc2_datetime_t d = {0};
+  uint8_t ret;
+
+  ds1302_sim_reset();
+  rtc2_init();
+
+  // Sunday 19th October 2025, 23:59:50
+  d.seconds = 50;
+  d.minutes = 59;
+  d.hours = 23;
+  d.date = 19;
+  d.month = 10;
+  d.year = 25;
+  d.wday = 0;
+  rtc2_preset(&d);
+
+  rtc2_health_init();
+
+  // backoff left from previous check runs out on healthy bus
+  skipped_calls(&ret);
+}
+
+// calls rtc2_get_checked until it returns something else than
+// RTC2_ERR_BACKOFF, returns number of skipped calls. skipped calls
+// must not touch the bus.
+static uint16_t skipped_calls(uint8_t *ret){
+  uint16_t n = 0;
+  double t;
+
+  for(;;){
+    t = ds1302_sim_time_us;
+    *ret = rtc2_get_checked(&now, RTC2_ALL_FIELDS);
+
+    if(*ret != RTC2_ERR_BACKOFF)
+      return n;
+
+    ds1302_sim_expect(ds1302_sim_time_us == t, "backoff call touched the bus");
+    ++n;
+  }
+}
+
+// Healthy bus {{{
+static void check_healthy(void){
+  uint8_t buf[4], ret;
+
+  setup();
+
+  ret = rtc2_get_checked(&now, RTC2_ALL_FIELDS);
+  ds1302_sim_expect(ret == RTC2_OK, "healthy bus: got %u", ret);
+  ds1302_sim_expect(now.wday == 0 && now.date == 19 && now.hours == 23,
+      "healthy bus: read back %u %u %u", now.wday, now.date, now.hours);
+
+  ret = rtc2_mem_read_checked(0, sizeof(buf), buf);
+  ds1302_sim_expect(ret == RTC2_OK, "healthy RAM read: got %u", ret);
+
+  ret = rtc2_mem_read_checked(60, sizeof(buf), buf);
+  ds1302_sim_expect(ret == RTC2_ERR_ARGS, "RAM read past the end: got %u", ret);
+
+  // weekday 4..6 must survive write/read
+  now.wday = 6;
+  rtc2_set(&now, RTC2_WDAY_FIELD);
+  ret = rtc2_get_checked(&now, RTC2_WDAY_FIELD);
+  ds1302_sim_expect(ret == RTC2_OK && now.wday == 6, "wday 6: got %u/%u", ret, now.wday);
+}
+// }}}
+
+// Stuck I/O line {{{
+static void check_stuck(uint8_t fault, const char *name){
+  static const uint8_t expected[] = {1, 2, 4, 8, 16, 32, 64, 64, 64};
+  uint8_t i, ret;
+  uint16_t n;
+
+  setup();
+  ds1302_sim_fault = fault;
+
+  ret = rtc2_get_checked(&now, RTC2_ALL_FIELDS);
+  ds1302_sim_expect(ret == RTC2_ERR_BUS, "%s: first call got %u", name, ret);
+
+  // backoff doubles and saturates at RTC2_HEALTH_MAX_BACKOFF
+  for(i = 0; i < sizeof(expected); ++i){
+    n = skipped_calls(&ret);
+
+    ds1302_sim_expect(ret == RTC2_ERR_BUS, "%s: probe %u got %u", name, i, ret);
+    ds1302_sim_expect(n == expected[i], "%s: backoff %u is %u, expected %u",
+        name, i, n, expected[i]);
+  }
+
+  // successful probe resets backoff
+  ds1302_sim_fault = DS1302_SIM_OK;
+  n = skipped_calls(&ret);
+  ds1302_sim_expect(ret == RTC2_OK, "%s: recovery got %u after %u skips", name, ret, n);
+
+  ds1302_sim_fault = fault;
+  rtc2_get_checked(&now, RTC2_ALL_FIELDS);
+  n = skipped_calls(&ret);
+  ds1302_sim_expect(n == 1, "%s: backoff after recovery is %u", name, n);
+}
+// }}}
+
+// Out of range fields {{{
+static void check_range(void){
+  uint8_t ret;
+  uint16_t n;
+
+  setup();
+
+  // 35th day of month
+  ds1302_sim_reg[3] = 0x35;
+
+  ret = rtc2_get_checked(&now, RTC2_SECONDS_FIELD);
+  ds1302_sim_expect(ret == RTC2_OK, "seconds only read checked date: got %u", ret);
+
+  ret = rtc2_get_checked(&now, RTC2_ALL_FIELDS);
+  ds1302_sim_expect(ret == RTC2_ERR_RANGE, "date 35: got %u", ret);
+
+  n = skipped_calls(&ret);
+  ds1302_sim_expect(n == 1 && ret == RTC2_ERR_RANGE, "date 35: %u skips, then %u", n, ret);
+
+  // hour 13 in 12 hours mode
+  ds1302_sim_reg[3] = 0x19;
+  ds1302_sim_reg[2] = 0x80 | 0x13;
+  n = skipped_calls(&ret);
+  ds1302_sim_expect(ret == RTC2_ERR_RANGE, "12h hour 13: got %u", ret);
+
+  ds1302_sim_reg[2] = 0x80 | 0x20 | 0x12;
+  n = skipped_calls(&ret);
+  ds1302_sim_expect(ret == RTC2_OK, "12 PM: got %u", ret);
+
+  // units digit above 9 decodes within range, 0x1A as 20
+  ds1302_sim_reg[0] = 0x1A;
+  ret = rtc2_get_checked(&now, RTC2_SECONDS_FIELD);
+  ds1302_sim_expect(ret == RTC2_ERR_RANGE, "seconds 0x1A: got %u", ret);
+
+  ds1302_sim_reg[0] = 0x10;
+  ds1302_sim_reg[6] = 0x2F;
+  n = skipped_calls(&ret);
+  ds1302_sim_expect(ret == RTC2_ERR_RANGE, "year 0x2F: got %u", ret);
+
+  ds1302_sim_reg[6] = 0x25;
+  n = skipped_calls(&ret);
+  ds1302_sim_expect(ret == RTC2_OK, "year 0x25 after bad BCD: got %u", ret);
+}
+// }}}
+
+int main(void){
+  check_healthy();
+  check_stuck(DS1302_SIM_IO_HIGH, "I/O stuck high");
+  // reads all zeroes, so only canary can catch it
+  check_stuck(DS1302_SIM_IO_LOW, "I/O stuck low");
+  check_range();
+
+  return ds1302_sim_report("rtc2_health_check");
+}
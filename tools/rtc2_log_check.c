@@ -0,0 +1,88 @@
+// vim: foldmethod=marker
+// Host side check of event ring log (RTC2_LOG) against DS1302
+// simulator: recovery from garbage, wrap around and power loss at
+// every point of append.
+//
+// build: make rtc2_log_check rtc2_log_check_6 (largest log that fits)
+#include <stdio.h>
+#include <string.h>
+
+#include "rtc2.h"
+#include "ds1302_sim.h"
+
+#if !RTC2_LOG
+#error "build with RTC2_LOG=1"
+#endif
+
+#define BASE 1792404930UL
+#define KEPT (RTC2_LOG_SLOTS - 1)
+
+static rtc2_log_t log;
+static rtc2_log_entry_t entries[KEPT];
+
+// record k of the sequence appended below
+static uint32_t record_time(uint8_t k){
+  return BASE + k * 100UL + (k >= 5 ? 70000UL : 0);
+}
+
+// last KEPT records out of count appended must be there
+static uint8_t log_holds(uint8_t count){
+  uint8_t n = rtc2_log_init(&log, entries), i, first = count > KEPT ? count - KEPT : 0;
+
+  if(n != count - first)
+    return 0;
+
+  for(i = 0; i < n; ++i)
+    if(entries[i].time != record_time(first + i) || entries[i].code != 0x10 + first + i)
+      return 0;
+
+  return 1;
+}
+
+int main(void){
+  uint8_t before[31], after[31], order[31], changed = 0, i, k, n;
+
+  ds1302_sim_reset();
+  rtc2_init();
+
+  // random RAM content is not a log
+  memset(ds1302_sim_ram, 0x5A, sizeof(ds1302_sim_ram));
+  n = rtc2_log_init(&log, entries);
+  ds1302_sim_expect(n == 0, "garbage gives %u records", n);
+  ds1302_sim_expect(rtc2_log_init(&log, entries) == 0, "garbage wasn't cleared");
+
+  // fill and wrap around. delta of 70000 s before record 5 saturates,
+  // so only windows starting at record 5 are exact
+  for(k = 0; k < 5 + 2 * RTC2_LOG_SLOTS; ++k){
+    rtc2_log_append(&log, record_time(k), 0x10 + k);
+
+    if(k < 5 || k + 1 >= 5 + KEPT)
+      ds1302_sim_expect(log_holds(k + 1), "after %u appends", k + 1);
+  }
+
+  // Power loss during append {{{
+  // append writes changed record bytes first and then burst of both
+  // headers, every prefix of that must recover as old or new log
+  memcpy(before, ds1302_sim_ram, sizeof(before));
+  rtc2_log_append(&log, record_time(k), 0x10 + k);
+  memcpy(after, ds1302_sim_ram, sizeof(after));
+
+  for(i = 12; i < sizeof(before); ++i)
+    if(before[i] != after[i])
+      order[changed++] = i;
+
+  for(i = 0; i < 12; ++i)
+    order[changed++] = i;
+
+  for(n = 0; n <= changed; ++n){
+    memcpy(ds1302_sim_ram, before, sizeof(before));
+
+    for(i = 0; i < n; ++i)
+      ds1302_sim_ram[order[i]] = after[order[i]];
+
+    ds1302_sim_expect(log_holds(k) || log_holds(k + 1), "power lost after %u bytes of append", n);
+  }
+  // }}}
+
+  return ds1302_sim_report(RTC2_LOG_SLOTS == 6 ? "rtc2_log_check_6" : "rtc2_log_check");
+}
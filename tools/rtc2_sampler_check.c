@@ -0,0 +1,117 @@
+// vim: foldmethod=marker
+// Host side check of delta encoded sampler (RTC2_SAMPLER) against
+// DS1302 simulator: mostly fast sampling across minute, day and year
+// rollovers with occasional gaps of a minute and more.
+//
+// build: make rtc2_sampler_check
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "rtc2.h"
+#include "ds1302_sim.h"
+
+#if !RTC2_SAMPLER
+#error "build with RTC2_SAMPLER=1"
+#endif
+
+#define SAMPLES 5000
+
+static uint8_t from_bcd(uint8_t v){
+  return (v & 0x0F) + (v >> 4) * 10;
+}
+
+// timestamp of simulated clock, without touching the bus
+static uint32_t clock_now(void){
+  rtc2_datetime_t d = {0};
+
+  d.seconds = from_bcd(ds1302_sim_reg[0]);
+  d.minutes = from_bcd(ds1302_sim_reg[1]);
+  d.hours = from_bcd(ds1302_sim_reg[2]);
+  d.date = from_bcd(ds1302_sim_reg[3]);
+  d.month = from_bcd(ds1302_sim_reg[4]);
+  d.year = from_bcd(ds1302_sim_reg[6]);
+
+  return rtc2_timestamp(&d);
+}
+
+// same as tools/rtc2_samples
+static uint8_t decode(rtc2_sampler_t *s, uint32_t *ts, uint8_t first){
+  uint32_t val = 0;
+  uint8_t shift = 0, byte;
+
+  do{
+    if(!rtc2_sampler_pop(s, &byte))
+      return 0;
+
+    val |= (uint32_t)(byte & 0x7F) << shift;
+    shift += 7;
+  }while(byte & 0x80);
+
+  if(first)
+    *ts = val + RTC2_BASE_TIMESTAMP;
+  else if(val & 1)
+    *ts -= (val + 1) >> 1;
+  else
+    *ts += val >> 1;
+
+  return 1;
+}
+
+static void check_run(uint8_t hints){
+  uint32_t before, after, ts = 0, bytes = 0, i;
+  double gap = 0, bus = 0, t;
+  rtc2_datetime_t d = {0};
+  rtc2_sampler_t s;
+  uint8_t buf[16], dummy;
+
+  ds1302_sim_reset();
+  rtc2_init();
+  srand(1);
+
+  // 31st December 2026, 23:58:50
+  d.seconds = 50;
+  d.minutes = 58;
+  d.hours = 23;
+  d.date = 31;
+  d.month = 12;
+  d.year = 26;
+  rtc2_preset(&d);
+
+  rtc2_sampler_init(&s, buf, sizeof(buf));
+
+  for(i = 0; i < SAMPLES; ++i){
+    before = clock_now();
+    t = ds1302_sim_time_us;
+    rtc2_sample(&s, !hints || gap >= 65.535e6 ? RTC2_SAMPLER_UNKNOWN : (uint16_t)(gap / 1000));
+    bus += ds1302_sim_time_us - t;
+    after = clock_now();
+
+    bytes += s.len;
+
+    if(!ds1302_sim_expect(decode(&s, &ts, !i), "sample %lu: nothing stored", (unsigned long)i))
+      return;
+
+    ds1302_sim_expect(ts == before || ts == after, "sample %lu: got %lu, clock %lu",
+        (unsigned long)i, (unsigned long)ts, (unsigned long)before);
+
+    while(rtc2_sampler_pop(&s, &dummy));
+
+    // every 50th gap is 50 s .. 1 hour, the rest up to 0.2 s
+    if(i % 50 == 49)
+      gap = 50e6 + 3550e6 * rand() / RAND_MAX;
+    else
+      gap = 200e3 * rand() / RAND_MAX;
+
+    ds1302_sim_idle(gap);
+  }
+
+  printf("%s: %.2f bytes/sample, %.0f us of bus per sample\n",
+      hints ? "elapsed hints" : "no hints", (double)bytes / SAMPLES, bus / SAMPLES);
+}
+
+int main(void){
+  check_run(1);
+  check_run(0);
+
+  return ds1302_sim_report("rtc2_sampler_check");
+}
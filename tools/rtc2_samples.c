@@ -0,0 +1,62 @@
+// Host side decoder for rtc2_sampler_t byte stream (see RTC2_SAMPLER
+// in rtc2.h). Prints one UNIX timestamp and UTC date per sample.
+//
+// build: cc -std=gnu99 -O2 -o rtc2_samples tools/rtc2_samples.c
+// usage: rtc2_samples < samples.bin
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+// same as in rtc2.h
+#define RTC2_BASE_TIMESTAMP 946684800
+
+int main(void){
+  uint32_t val = 0, ts = 0;
+  unsigned long count = 0, bytes = 0;
+  uint8_t shift = 0;
+  int c;
+
+  while((c = getchar()) != EOF){
+    ++bytes;
+    val |= (uint32_t)(c & 0x7F) << shift;
+    shift += 7;
+
+    if(c & 0x80){
+      if(shift > 28){
+        fprintf(stderr, "broken varint at byte %lu\n", bytes);
+        return 1;
+      }
+
+      continue;
+    }
+
+    // first value is absolute, the rest are zigzag deltas
+    if(!count)
+      ts = val + RTC2_BASE_TIMESTAMP;
+    else if(val & 1)
+      ts -= (val + 1) >> 1;
+    else
+      ts += val >> 1;
+
+    {
+      char buf[32];
+      time_t t = ts;
+
+      strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", gmtime(&t));
+      printf("%lu %s\n", (unsigned long)ts, buf);
+    }
+
+    ++count;
+    val = shift = 0;
+  }
+
+  if(shift){
+    fprintf(stderr, "truncated varint at the end\n");
+    return 1;
+  }
+
+  fprintf(stderr, "%lu samples, %lu bytes, %.2f bytes per sample\n",
+      count, bytes, count ? (double)bytes / count : 0.0);
+
+  return 0;
+}
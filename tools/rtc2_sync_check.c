@@ -0,0 +1,121 @@
+// vim: foldmethod=marker
+// Host side check of second boundary phase tracker (RTC2_SYNC_TRACK)
+// against DS1302 simulator with MCU timer and crystal errors.
+//
+// build: make rtc2_sync_check rtc2_sync_check_ms
+//
+// rtc2_sync_check uses default microsecond ticks and checks that large
+// MCU timer errors are corrected after the first call. rtc2_sync_check_ms
+// uses millisecond ticks and 10us polls to check gaps of many hours
+// and poll counts above 65535.
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "rtc2.h"
+#include "ds1302_sim.h"
+
+#if !(RTC2_SYNC && RTC2_SYNC_TRACK)
+#error "build with RTC2_SYNC_TRACK=1"
+#endif
+
+// reads per rtc2_sync_wait once period is known: guard window and
+// a poll interval on both sides, each poll is 1 read
+#define MAX_READS (2 * RTC2_SYNC_GUARD * (1000000UL / RTC2_SYNC_TICKS_PER_SECOND) / RTC2_SYNC_POLL_US + 4)
+
+// MCU time of last clock increment, ticks
+static uint32_t true_edge(void){
+  double us = ds1302_sim_time_us - ds1302_sim_phase_us() / (1 + ds1302_sim_ppm / 1e6);
+
+  return (uint32_t)(uint64_t)(us * (1 + ds1302_sim_mcu_ppm / 1e6) * RTC2_SYNC_TICKS_PER_SECOND / 1e6);
+}
+
+// MCU sleeps until given RTC2_SYNC_TIME
+static void idle_until(uint32_t t){
+  int32_t left;
+
+  while((left = (int32_t)(t - RTC2_SYNC_TIME)) > 0)
+    ds1302_sim_idle(left * 1e6 / RTC2_SYNC_TICKS_PER_SECOND / (1 + ds1302_sim_mcu_ppm / 1e6));
+}
+
+// runs tracker for given number of calls with random gaps up to
+// max_gap seconds. after the first call reads per wait must stay
+// within guard window and edge must be found within a poll
+static void check_track(double mcu_ppm, double rtc_ppm, double max_gap, uint16_t calls){
+  uint32_t reads = 0, worst_reads = 0, i;
+  int32_t err, worst_err = 0;
+  double t, busy, worst_busy = 0;
+  rtc2_sync_t s;
+
+  ds1302_sim_reset();
+  ds1302_sim_mcu_ppm = mcu_ppm;
+  ds1302_sim_ppm = rtc_ppm;
+  rtc2_init();
+  srand(1);
+
+  ds1302_sim_idle(1e6 * rand() / RAND_MAX);
+  ds1302_sim_expect(rtc2_sync_init(&s) != RTC2_SYNC_TIMEOUT, "sync init timed out");
+
+  for(i = 0; i < calls; ++i){
+    ds1302_sim_idle(max_gap * 1e6 * rand() / RAND_MAX);
+    idle_until(rtc2_sync_next(&s));
+
+    reads = ds1302_sim_transfers;
+    t = ds1302_sim_time_us;
+
+    if(!ds1302_sim_expect(rtc2_sync_wait(&s) != RTC2_SYNC_TIMEOUT, "sync wait timed out"))
+      return;
+
+    reads = ds1302_sim_transfers - reads;
+    busy = ds1302_sim_time_us - t;
+    err = (int32_t)(s.edge - true_edge());
+
+    // first call re-estimates period, from then on it must hold
+    if(i){
+      if(reads > worst_reads)
+        worst_reads = reads;
+
+      if(busy > worst_busy)
+        worst_busy = busy;
+
+      if(abs(err) > abs(worst_err))
+        worst_err = err;
+    }
+  }
+
+  printf("MCU %+.0f ppm, RTC %+.0f ppm, gaps up to %.0f s: %lu reads/wait in %.0f us, edge error %ld ticks\n",
+      mcu_ppm, rtc_ppm, max_gap, (unsigned long)worst_reads, worst_busy, (long)worst_err);
+
+  ds1302_sim_expect(worst_reads <= MAX_READS, "%lu reads per wait, expected at most %lu",
+      (unsigned long)worst_reads, (unsigned long)MAX_READS);
+
+  // no idling inside, only polls (a read is below 100us)
+  ds1302_sim_expect(worst_busy <= MAX_READS * (RTC2_SYNC_POLL_US + 100.0), "wait blocked for %.0f us", worst_busy);
+
+  // half of poll interval plus one read, plus tick resolution
+  ds1302_sim_expect(abs(worst_err) <= (RTC2_SYNC_POLL_US + 100) * RTC2_SYNC_TICKS_PER_SECOND / 1000000UL + 1,
+      "edge error %ld ticks", (long)worst_err);
+}
+
+int main(void){
+#if RTC2_SYNC_TICKS_PER_SECOND == 1000000UL
+  check_track(0, 0, 3, 50);
+  check_track(0, 20, 600, 50);
+  // RC oscillators: whole percents either way
+  check_track(50000, 0, 3, 50);
+  check_track(-30000, 20, 600, 50);
+  check_track(100000, -20, 20, 50);
+#else
+  // gaps of many hours, 65535 rollovers is a bit more than 18 hours
+  check_track(0, 0, 86400, 20);
+#endif
+
+  // halted clock times out after 1.1 s of poll intervals, reads take
+  // 10 times more with 10us polls
+  ds1302_sim_reset();
+  rtc2_init();
+  ds1302_sim_reg[0] |= 0x80;
+  ds1302_sim_expect(rtc2_wait_second_edge() == RTC2_SYNC_TIMEOUT, "halted clock didn't time out");
+  ds1302_sim_expect(ds1302_sim_time_us < 20e6, "timeout took %.1f s", ds1302_sim_time_us / 1e6);
+
+  return ds1302_sim_report(RTC2_SYNC_TICKS_PER_SECOND == 1000000UL ? "rtc2_sync_check" : "rtc2_sync_check_ms");
+}
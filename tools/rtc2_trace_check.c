@@ -0,0 +1,57 @@
+// vim: foldmethod=marker
+// Host side check of bus timing (RTC2_TRACE) against datasheet limits:
+// traces a few transfers on DS1302 simulator, dumps them the way
+// firmware would and runs tools/rtc2_vcd on the dump.
+//
+// build: make rtc2_trace_check (needs rtc2_vcd next to it)
+#include <stdio.h>
+#include <sys/wait.h>
+
+#include "rtc2.h"
+#include "ds1302_sim.h"
+
+#if !RTC2_TRACE
+#error "build with RTC2_TRACE=1"
+#endif
+
+int main(void){
+  rtc2_datetime_t d = {0};
+  uint8_t i, n;
+  FILE *vcd;
+  int status;
+
+  ds1302_sim_reset();
+  rtc2_init();
+
+  ds1302_sim_expect(rtc2_trace_overhead() > 0, "no trace overhead measured");
+
+  // write followed by two reads right after each other,
+  // so there are CE gaps to measure too
+  d.seconds = 42;
+  rtc2_set(&d, RTC2_SECONDS_FIELD);
+  rtc2_get(&d, RTC2_SECONDS_FIELD | RTC2_MINUTES_FIELD);
+
+  ds1302_sim_expect(d.seconds == 42, "traced read got %u seconds", d.seconds);
+
+  n = rtc2_trace_count();
+  ds1302_sim_expect(n < RTC2_TRACE_SIZE, "trace buffer overflowed");
+
+  fflush(stdout);
+
+  if(!ds1302_sim_expect((vcd = popen("./rtc2_vcd", "w")) != NULL, "can't run rtc2_vcd"))
+    return ds1302_sim_report("rtc2_trace_check");
+
+  fprintf(vcd, "C %u\n", rtc2_trace_overhead());
+
+  for(i = 0; i < n; ++i)
+    fprintf(vcd, "T %u %02X\n", rtc2_trace_get(i)->time, rtc2_trace_get(i)->flags);
+
+  status = pclose(vcd);
+  status = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+
+  // rtc2_vcd exits with 2 on violations
+  ds1302_sim_expect(status != 2, "bus timing violates datasheet");
+  ds1302_sim_expect(status == 0 || status == 2, "rtc2_vcd failed with %d", status);
+
+  return ds1302_sim_report("rtc2_trace_check");
+}
@@ -0,0 +1,78 @@
+// vim: foldmethod=marker
+// Host side check of timezone conversion (RTC2_TZ) against glibc
+// localtime_r for 2000..2099 with the same zones given as POSIX TZ
+// strings, so no tzdata is needed.
+//
+// build: make rtc2_tz_check
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "rtc2.h"
+#include "ds1302_sim.h"
+
+#if !RTC2_TZ
+#error "build with RTC2_TZ=1"
+#endif
+
+// 2nd January 2000 .. 30th December 2099 UTC, so local time of every
+// zone stays in the range rtc2_localtime handles. step is coprime
+// with an hour, so transitions are hit at every minute over the years.
+#define FROM 946771200UL
+#define TO   4102358400UL
+#define STEP 1799
+
+typedef struct {
+  const char *posix;
+  rtc2_tz_t tz;
+} zone_t;
+
+static const zone_t zones[] = {
+  {"CET-1CEST,M3.5.0,M10.5.0/3",        {60, 120, {3, 5, 0, 120}, {10, 5, 0, 180}}},
+  {"GMT0BST,M3.5.0/1,M10.5.0",          {0, 60, {3, 5, 0, 60}, {10, 5, 0, 120}}},
+  {"EST5EDT,M3.2.0,M11.1.0",            {-300, -240, {3, 2, 0, 120}, {11, 1, 0, 120}}},
+  {"AEST-10AEDT,M10.1.0,M4.1.0/3",      {600, 660, {10, 1, 0, 120}, {4, 1, 0, 180}}},
+  {"NZST-12NZDT,M9.5.0,M4.1.0/3",       {720, 780, {9, 5, 0, 120}, {4, 1, 0, 180}}},
+  {"<+1030>-10:30<+11>-11,M10.1.0,M4.1.0", {630, 660, {10, 1, 0, 120}, {4, 1, 0, 120}}},
+  {"IST-5:30",                          {330, 330, {1, 1, 0, 0}, {1, 1, 0, 0}}},
+  {"<-03>3",                            {-180, -180, {1, 1, 0, 0}, {1, 1, 0, 0}}},
+};
+
+int main(void){
+  unsigned long count = 0;
+  uint32_t utc, local, back;
+  rtc2_tz_cache_t cache;
+  uint8_t i;
+
+  for(i = 0; i < sizeof(zones) / sizeof(*zones); ++i){
+    setenv("TZ", zones[i].posix, 1);
+    tzset();
+    rtc2_tz_init(&cache, &zones[i].tz);
+
+    for(utc = FROM; utc < TO; utc += STEP, ++count){
+      time_t t = utc;
+      struct tm tm;
+
+      localtime_r(&t, &tm);
+      local = rtc2_utc_to_local(&cache, utc);
+
+      if(!ds1302_sim_expect(local == utc + tm.tm_gmtoff, "%s: utc %lu gives %lu, glibc %lu",
+            zones[i].posix, (unsigned long)utc, (unsigned long)local,
+            (unsigned long)(utc + tm.tm_gmtoff)))
+        continue;
+
+      // round trip is exact except for the repeated hour at DST end,
+      // which maps back to its earlier (daylight) instance
+      back = rtc2_local_to_utc(&cache, local);
+
+      if(back != utc)
+        ds1302_sim_expect(back < utc && rtc2_utc_to_local(&cache, back) == local,
+            "%s: utc %lu -> local %lu -> utc %lu", zones[i].posix,
+            (unsigned long)utc, (unsigned long)local, (unsigned long)back);
+    }
+  }
+
+  printf("%lu timestamps in %u zones\n", count, i);
+  return ds1302_sim_report("rtc2_tz_check");
+}
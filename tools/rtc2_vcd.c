@@ -0,0 +1,290 @@
+// vim: foldmethod=marker
+// Host side tool converting DS1302 bus trace (see RTC2_TRACE in rtc2.h)
+// into VCD file and printing timing report against datasheet limits.
+//
+// build: cc -std=gnu99 -O2 -o rtc2_vcd tools/rtc2_vcd.c
+// usage: rtc2_vcd [-n ns_per_tick] [-5] [-o out.vcd] < trace.log
+//
+// input lines look like "T <time> <flags in hex>", everything else
+// is ignored so raw USART log can be fed as is. time is 16 bit
+// counter value, wraps are unrolled assuming that no two consecutive
+// entries are more than 65535 ticks apart.
+//
+// "C <ticks>" line gives rtc2_trace_overhead(). every entry delayed
+// the bus by that much, so it is taken off each interval following
+// it, giving timing of a build without RTC2_TRACE.
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+// same as in rtc2.h
+#define RTC2_TRACE_CE     0x01
+#define RTC2_TRACE_CLK    0x02
+#define RTC2_TRACE_IO     0x04
+#define RTC2_TRACE_IO_OUT 0x08
+#define RTC2_TRACE_SAMPLE 0x10
+
+// Datasheet AC characteristics, nanoseconds {{{
+typedef struct {
+  const char *name;
+  const char *descr;
+  uint32_t limit_2v;
+  uint32_t limit_5v;
+} rtc2_limit_t;
+
+enum {
+  T_DC,  // data to CLK setup
+  T_CDH, // CLK to data hold
+  T_CDD, // CLK to data delay (max, our sample must come later)
+  T_CL,  // CLK low time
+  T_CH,  // CLK high time
+  T_CC,  // CE to CLK setup
+  T_CWH, // CE inactive time
+  T_CCZ, // CE to I/O high impedance (max, we must not drive earlier)
+  T_COUNT
+};
+
+static const rtc2_limit_t limits[T_COUNT] = {
+  {"tDC",  "data to CLK setup",       200,  50},
+  {"tCDH", "CLK to data hold",        280,  70},
+  {"tCDD", "CLK to data delay",       800, 200},
+  {"tCL",  "CLK low time",           1000, 250},
+  {"tCH",  "CLK high time",          1000, 250},
+  {"tCC",  "CE to CLK setup",        4000, 1000},
+  {"tCWH", "CE inactive time",       4000, 1000},
+  {"tCCZ", "CE to I/O high-Z",        280,  70},
+};
+// }}}
+
+// Statistics accumulator {{{
+typedef struct {
+  uint64_t min, max, sum;
+  uint32_t count;
+} stat_t;
+
+static void stat_add(stat_t *s, uint64_t v){
+  if(!s->count || v < s->min)
+    s->min = v;
+
+  if(!s->count || v > s->max)
+    s->max = v;
+
+  s->sum += v;
+  ++s->count;
+}
+
+static void stat_print(const char *name, const stat_t *s){
+  if(!s->count){
+    printf("  %-14s  no samples\n", name);
+    return;
+  }
+
+  printf("  %-14s  min %8llu  avg %8llu  max %8llu ns  (%u)\n", name,
+      (unsigned long long)s->min, (unsigned long long)(s->sum / s->count),
+      (unsigned long long)s->max, s->count);
+}
+// }}}
+
+// VCD output {{{
+static void vcd_header(FILE *f){
+  fputs("$timescale 1ns $end\n"
+        "$scope module ds1302 $end\n"
+        "$var wire 1 c CE $end\n"
+        "$var wire 1 k SCLK $end\n"
+        "$var wire 1 d IO $end\n"
+        "$var wire 1 o IO_OUT $end\n"
+        "$var event 1 s SAMPLE $end\n"
+        "$upscope $end\n"
+        "$enddefinitions $end\n", f);
+}
+
+static void vcd_entry(FILE *f, uint64_t t, uint8_t prev, uint8_t flags, int first){
+  static const struct { uint8_t bit; char id; } sig[] = {
+    {RTC2_TRACE_CE, 'c'}, {RTC2_TRACE_CLK, 'k'},
+    {RTC2_TRACE_IO, 'd'}, {RTC2_TRACE_IO_OUT, 'o'}
+  };
+  unsigned i;
+
+  fprintf(f, "#%llu\n", (unsigned long long)t);
+
+  for(i = 0; i < sizeof(sig) / sizeof(*sig); ++i)
+    if(first || ((prev ^ flags) & sig[i].bit))
+      fprintf(f, "%c%c\n", flags & sig[i].bit ? '1' : '0', sig[i].id);
+
+  if(flags & RTC2_TRACE_SAMPLE)
+    fputs("1s\n", f);
+}
+// }}}
+
+static void usage(const char *name){
+  fprintf(stderr, "usage: %s [-n ns_per_tick] [-5] [-o out.vcd] < trace.log\n"
+                  "  -n  trace counter tick length in ns (default 1000)\n"
+                  "  -5  check against 5V limits (default 2V)\n"
+                  "  -o  write VCD file\n", name);
+  exit(1);
+}
+
+int main(int argc, char **argv){
+  FILE *vcd = NULL;
+  uint32_t tick = 1000;
+  int opt, volts5 = 0, first = 1;
+  char line[128];
+
+  unsigned raw, flags, cost = 0;
+  uint16_t last_raw = 0, delta;
+  uint64_t t = 0;
+  uint8_t prev = 0;
+
+  // times of last interesting events, UINT64_MAX when unknown
+  uint64_t ce_rise = UINT64_MAX, ce_fall = UINT64_MAX;
+  uint64_t clk_rise = UINT64_MAX, clk_fall = UINT64_MAX;
+  uint64_t io_change = UINT64_MAX;
+  int first_clk = 0;
+
+  stat_t period = {0}, tr = {0}, st[T_COUNT];
+  uint32_t i, violations = 0;
+
+  memset(st, 0, sizeof(st));
+
+  while((opt = getopt(argc, argv, "n:5o:")) != -1){
+    switch(opt){
+      case 'n':
+        tick = strtoul(optarg, NULL, 10);
+        break;
+      case '5':
+        volts5 = 1;
+        break;
+      case 'o':
+        if(!(vcd = fopen(optarg, "w"))){
+          perror(optarg);
+          return 1;
+        }
+        break;
+      default:
+        usage(argv[0]);
+    }
+  }
+
+  if(vcd)
+    vcd_header(vcd);
+
+  while(fgets(line, sizeof(line), stdin)){
+    uint8_t changed;
+
+    if(sscanf(line, " C %u", &cost) == 1)
+      continue;
+
+    if(sscanf(line, " T %u %x", &raw, &flags) != 2)
+      continue;
+
+    if(!first){
+      delta = raw - last_raw;
+      t += (delta > cost ? delta - cost : 0) * (uint64_t)tick;
+    }
+
+    last_raw = raw;
+    changed = first ? 0 : (prev ^ flags);
+
+    if(vcd)
+      vcd_entry(vcd, t, prev, flags, first);
+
+    // CE edges: transactions, tCC, tCWH {{{
+    if(changed & RTC2_TRACE_CE){
+      if(flags & RTC2_TRACE_CE){
+        if(ce_fall != UINT64_MAX)
+          stat_add(&st[T_CWH], t - ce_fall);
+
+        ce_rise = t;
+        first_clk = 1;
+      }else{
+        if(ce_rise != UINT64_MAX)
+          stat_add(&tr, t - ce_rise);
+
+        ce_fall = t;
+        ce_rise = UINT64_MAX;
+      }
+    }
+    // }}}
+
+    // IO driven by MCU: tCCZ, tDC, tCDH {{{
+    if((changed & RTC2_TRACE_IO_OUT) && (flags & RTC2_TRACE_IO_OUT) && ce_fall != UINT64_MAX)
+      stat_add(&st[T_CCZ], t - ce_fall);
+
+    if((flags & RTC2_TRACE_IO_OUT) && (changed & (RTC2_TRACE_IO | RTC2_TRACE_IO_OUT))){
+      if((flags & RTC2_TRACE_CE) && (flags & RTC2_TRACE_CLK) && clk_rise != UINT64_MAX)
+        stat_add(&st[T_CDH], t - clk_rise);
+
+      io_change = t;
+    }
+    // }}}
+
+    // CLK edges: period, widths, tCC, tDC {{{
+    if(changed & RTC2_TRACE_CLK){
+      if(flags & RTC2_TRACE_CLK){
+        if(flags & RTC2_TRACE_CE){
+          if(first_clk){
+            stat_add(&st[T_CC], t - ce_rise);
+            first_clk = 0;
+          }else if(clk_rise != UINT64_MAX)
+            stat_add(&period, t - clk_rise);
+
+          if(clk_fall != UINT64_MAX && clk_fall > ce_rise)
+            stat_add(&st[T_CL], t - clk_fall);
+
+          if((flags & RTC2_TRACE_IO_OUT) && io_change != UINT64_MAX)
+            stat_add(&st[T_DC], t - io_change);
+        }
+
+        clk_rise = t;
+      }else{
+        if((prev & RTC2_TRACE_CE) && clk_rise != UINT64_MAX)
+          stat_add(&st[T_CH], t - clk_rise);
+
+        clk_fall = t;
+      }
+    }
+    // }}}
+
+    // tCDD: MCU sample after falling edge {{{
+    if((flags & RTC2_TRACE_SAMPLE) && clk_fall != UINT64_MAX)
+      stat_add(&st[T_CDD], t - clk_fall);
+    // }}}
+
+    prev = flags & ~RTC2_TRACE_SAMPLE;
+    first = 0;
+  }
+
+  if(vcd)
+    fclose(vcd);
+
+  // Report {{{
+  printf("Bus timing (%s limits, %u ns per tick, %u ticks of trace overhead per entry removed)\n",
+      volts5 ? "5V" : "2V", tick, cost);
+  stat_print("SCLK period", &period);
+  stat_print("transaction", &tr);
+  printf("\nDatasheet margins (min measured - limit)\n");
+
+  for(i = 0; i < T_COUNT; ++i){
+    uint32_t lim = volts5 ? limits[i].limit_5v : limits[i].limit_2v;
+    int64_t margin;
+
+    if(!st[i].count){
+      printf("  %-5s %-24s  no samples\n", limits[i].name, limits[i].descr);
+      continue;
+    }
+
+    margin = (int64_t)st[i].min - lim;
+
+    printf("  %-5s %-24s  min %8llu  limit %5u  margin %8lld ns%s\n",
+        limits[i].name, limits[i].descr, (unsigned long long)st[i].min,
+        lim, (long long)margin, margin < 0 ? "  VIOLATION" : "");
+
+    if(margin < 0)
+      ++violations;
+  }
+  // }}}
+
+  return violations ? 2 : 0;
+}
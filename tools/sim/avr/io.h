@@ -0,0 +1,26 @@
+#ifndef __RTC2_SIM_AVR_IO_H__
+#define __RTC2_SIM_AVR_IO_H__
+
+// Host stand-in for <avr/io.h>: only what rtc2.c uses with default
+// rtc2_config.h and RTC2_TRACE. Every port access goes through the
+// DS1302 simulator, see ds1302_sim.h.
+
+#include "ds1302_sim.h"
+
+#define PORTC (*ds1302_sim_port())
+#define DDRC  (*ds1302_sim_ddr())
+#define PINC  (ds1302_sim_pin())
+
+// Timer1 running at 1MHz (with ds1302_sim_mcu_ppm error), the default
+// RTC2_TRACE_TIME source
+#define TCNT1 (ds1302_sim_tcnt1())
+
+#define PC3 3
+#define PC4 4
+#define PC5 5
+
+#define _BV(bit) (1u << (bit))
+#define bit_is_set(sfr, bit) ((sfr) & _BV(bit))
+#define bit_is_clear(sfr, bit) (!((sfr) & _BV(bit)))
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef __RTC2_SIM_AVR_PGMSPACE_H__
+#define __RTC2_SIM_AVR_PGMSPACE_H__
+
+// Host stand-in for <avr/pgmspace.h>: flash is ordinary memory
+
+#include <stdint.h>
+#include <string.h>
+
+#define PROGMEM
+
+#define pgm_read_byte(addr)  (*(const uint8_t *)(addr))
+#define pgm_read_word(addr)  (*(const uint16_t *)(addr))
+#define pgm_read_dword(addr) (*(const uint32_t *)(addr))
+#define memcpy_P memcpy
+
+#endif
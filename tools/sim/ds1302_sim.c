@@ -0,0 +1,331 @@
+// vim: foldmethod=marker
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "ds1302_sim.h"
+
+// same pins as default rtc2_config.h
+#define SIM_CE  3
+#define SIM_IO  4
+#define SIM_CLK 5
+
+uint8_t ds1302_sim_reg[32];
+uint8_t ds1302_sim_ram[31];
+uint8_t ds1302_sim_fault;
+double ds1302_sim_ppm;
+double ds1302_sim_mcu_ppm;
+double ds1302_sim_time_us;
+uint32_t ds1302_sim_transfers;
+
+// Protocol state {{{
+enum {
+  SIM_IDLE,    // CE is low
+  SIM_COMMAND, // shifting in command byte
+  SIM_WRITE,   // shifting in data bytes
+  SIM_READ     // shifting out data bytes
+};
+
+static uint8_t sim_port, sim_ddr, sim_last;
+static uint8_t sim_state, sim_cmd, sim_shift, sim_out, sim_index;
+// bit being shifted, -1 right after read command till first falling edge
+static int8_t sim_bit;
+// microseconds accumulated towards next clock increment
+static double sim_rtc_us;
+// }}}
+
+static unsigned sim_checks, sim_failures;
+
+// Clock ticking {{{
+static uint8_t sim_from_bcd(uint8_t v){
+  return (v & 0x0F) + (v >> 4) * 10;
+}
+
+static uint8_t sim_to_bcd(uint8_t v){
+  return ((v / 10) << 4) | (v % 10);
+}
+
+static uint8_t sim_month_days(uint8_t month, uint8_t year){
+  static const uint8_t days[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+
+  if(month < 1 || month > 12)
+    return 31;
+
+  return days[month - 1] + (month == 2 && !(year % 4));
+}
+
+// increments hours register, returns 1 on day change
+static uint8_t sim_tick_hours(void){
+  uint8_t h = ds1302_sim_reg[2], hour;
+
+  if(!(h & 0x80)){
+    hour = sim_from_bcd(h & 0x3F) + 1;
+    ds1302_sim_reg[2] = sim_to_bcd(hour == 24 ? 0 : hour);
+    return hour == 24;
+  }
+
+  // 12 hours mode: 11 -> 12 flips AM/PM, 12 -> 1 keeps it
+  hour = sim_from_bcd(h & 0x1F);
+
+  if(hour == 12)
+    hour = 1;
+  else if(++hour == 12)
+    h ^= 0x20;
+
+  ds1302_sim_reg[2] = (h & 0xA0) | sim_to_bcd(hour);
+  return hour == 12 && !(h & 0x20);
+}
+
+static void sim_tick(void){
+  uint8_t v, date, month, year;
+
+  // clock halt
+  if(ds1302_sim_reg[0] & 0x80)
+    return;
+
+  if((v = sim_from_bcd(ds1302_sim_reg[0]) + 1) < 60){
+    ds1302_sim_reg[0] = sim_to_bcd(v);
+    return;
+  }
+
+  ds1302_sim_reg[0] = 0;
+
+  if((v = sim_from_bcd(ds1302_sim_reg[1]) + 1) < 60){
+    ds1302_sim_reg[1] = sim_to_bcd(v);
+    return;
+  }
+
+  ds1302_sim_reg[1] = 0;
+
+  if(!sim_tick_hours())
+    return;
+
+  ds1302_sim_reg[5] = ds1302_sim_reg[5] % 7 + 1;
+
+  date = sim_from_bcd(ds1302_sim_reg[3]);
+  month = sim_from_bcd(ds1302_sim_reg[4]);
+  year = sim_from_bcd(ds1302_sim_reg[6]);
+
+  if(++date > sim_month_days(month, year)){
+    date = 1;
+
+    if(++month > 12){
+      month = 1;
+      year = (year + 1) % 100;
+    }
+  }
+
+  ds1302_sim_reg[3] = sim_to_bcd(date);
+  ds1302_sim_reg[4] = sim_to_bcd(month);
+  ds1302_sim_reg[6] = sim_to_bcd(year);
+}
+
+static void sim_advance(double us){
+  ds1302_sim_time_us += us;
+  sim_rtc_us += us * (1 + ds1302_sim_ppm / 1e6);
+
+  while(sim_rtc_us >= 1e6){
+    sim_rtc_us -= 1e6;
+    sim_tick();
+  }
+}
+// }}}
+
+// Register file {{{
+// burst index i of clock/RAM burst, or addressed register
+static uint8_t *sim_target(uint8_t i){
+  uint8_t addr = sim_cmd & 0x7E;
+
+  if(addr == 0x3E)
+    return i < 8 ? &ds1302_sim_reg[i] : NULL;
+
+  if(addr == 0x7E)
+    return i < 31 ? &ds1302_sim_ram[i] : NULL;
+
+  if(i)
+    return NULL;
+
+  return addr & 0x40 ? &ds1302_sim_ram[(addr & 0x3E) >> 1] : &ds1302_sim_reg[addr >> 1];
+}
+
+static void sim_store(uint8_t val){
+  uint8_t *p = sim_target(sim_index++);
+
+  // only WP itself is writable while WP is set
+  if(!p || ((ds1302_sim_reg[7] & 0x80) && p != &ds1302_sim_reg[7]))
+    return;
+
+  *p = val;
+}
+
+static uint8_t sim_load(void){
+  uint8_t *p = sim_target(sim_index++);
+
+  return p ? *p : 0;
+}
+// }}}
+
+// Bus {{{
+// level on I/O line as seen by both sides
+static uint8_t sim_line(void){
+  if(ds1302_sim_fault == DS1302_SIM_IO_LOW)
+    return 0;
+
+  if(ds1302_sim_fault == DS1302_SIM_IO_HIGH)
+    return 1;
+
+  if(sim_ddr & (1 << SIM_IO))
+    return (sim_port >> SIM_IO) & 1;
+
+  if(sim_state == SIM_READ && sim_bit >= 0)
+    return (sim_out >> sim_bit) & 1;
+
+  return 0;
+}
+
+// reacts on pin changes since previous access
+static void sim_process(void){
+  uint8_t rise = (sim_port & ~sim_last) & (1 << SIM_CLK);
+  uint8_t fall = (~sim_port & sim_last) & (1 << SIM_CLK);
+
+  if(!(sim_port & (1 << SIM_CE))){
+    sim_state = SIM_IDLE;
+    sim_last = sim_port;
+    return;
+  }
+
+  if(!(sim_last & (1 << SIM_CE))){
+    ++ds1302_sim_transfers;
+    sim_state = SIM_COMMAND;
+    sim_bit = 0;
+    sim_shift = 0;
+    sim_index = 0;
+  }
+
+  if(rise && (sim_state == SIM_COMMAND || sim_state == SIM_WRITE)){
+    sim_shift |= sim_line() << sim_bit;
+
+    if(++sim_bit == 8){
+      sim_bit = 0;
+
+      if(sim_state == SIM_WRITE)
+        sim_store(sim_shift);
+      else if(!(sim_shift & 0x80))
+        // bit 7 must be set, otherwise chip ignores the transfer
+        sim_state = SIM_IDLE;
+      else if(sim_shift & 0x01){
+        sim_cmd = sim_shift;
+        sim_state = SIM_READ;
+        sim_out = sim_load();
+        sim_bit = -1;
+      }else{
+        sim_cmd = sim_shift;
+        sim_state = SIM_WRITE;
+      }
+
+      sim_shift = 0;
+    }
+  }else if(fall && sim_state == SIM_READ){
+    // output changes on falling edge, the first one after command
+    // puts out bit 0
+    if(++sim_bit == 8){
+      sim_bit = 0;
+      sim_out = sim_load();
+    }
+  }
+
+  sim_last = sim_port;
+}
+
+volatile uint8_t *ds1302_sim_port(void){
+  sim_process();
+  sim_advance(1);
+  return &sim_port;
+}
+
+volatile uint8_t *ds1302_sim_ddr(void){
+  sim_process();
+  return &sim_ddr;
+}
+
+uint8_t ds1302_sim_pin(void){
+  sim_process();
+  return sim_line() << SIM_IO;
+}
+// }}}
+
+void ds1302_sim_delay_us(double us){
+  sim_process();
+  sim_advance(us);
+}
+
+void ds1302_sim_idle(double us){
+  sim_process();
+  sim_advance(us);
+}
+
+void ds1302_sim_reset(void){
+  memset(ds1302_sim_reg, 0, sizeof(ds1302_sim_reg));
+  memset(ds1302_sim_ram, 0, sizeof(ds1302_sim_ram));
+
+  // 1st January 2000, Saturday
+  ds1302_sim_reg[3] = 0x01;
+  ds1302_sim_reg[4] = 0x01;
+  ds1302_sim_reg[5] = 0x06;
+
+  ds1302_sim_fault = DS1302_SIM_OK;
+  ds1302_sim_ppm = 0;
+  ds1302_sim_mcu_ppm = 0;
+  ds1302_sim_time_us = 0;
+  ds1302_sim_transfers = 0;
+
+  sim_port = sim_ddr = sim_last = 0;
+  sim_state = SIM_IDLE;
+  sim_rtc_us = 0;
+}
+
+double ds1302_sim_phase_us(void){
+  return sim_rtc_us;
+}
+
+// reading a timer takes some time too, keeps busy loops moving
+static double sim_mcu_us(void){
+  sim_advance(1);
+  return ds1302_sim_time_us * (1 + ds1302_sim_mcu_ppm / 1e6);
+}
+
+uint32_t rtc2_sync_ticks(void){
+  return (uint32_t)(uint64_t)sim_mcu_us();
+}
+
+uint32_t ds1302_sim_ms(void){
+  return (uint32_t)(uint64_t)(sim_mcu_us() / 1000);
+}
+
+uint16_t ds1302_sim_tcnt1(void){
+  return (uint16_t)(uint64_t)sim_mcu_us();
+}
+
+int ds1302_sim_expect(int cond, const char *fmt, ...){
+  va_list args;
+
+  ++sim_checks;
+
+  if(cond)
+    return cond;
+
+  ++sim_failures;
+
+  fputs("FAIL: ", stdout);
+  va_start(args, fmt);
+  vprintf(fmt, args);
+  va_end(args);
+  putchar('\n');
+
+  return cond;
+}
+
+int ds1302_sim_report(const char *name){
+  printf("%s: %u checks, %u failed\n", name, sim_checks, sim_failures);
+  return sim_failures ? 1 : 0;
+}
@@ -0,0 +1,86 @@
+// vim: foldmethod=marker
+#ifndef __DS1302_SIM_H__
+#define __DS1302_SIM_H__
+
+// Host side DS1302 simulator used by tools/*_check programs.
+//
+// rtc2.c is compiled for the host with -Itools/sim, so <avr/io.h>,
+// <util/delay.h> and <avr/pgmspace.h> resolve to the stand-ins next to
+// this file. PORTC/DDRC/PINC accesses are routed to the simulated chip
+// which decodes the 3-wire protocol from CE/SCLK/I/O edges, including
+// burst mode, write protection and clock halt.
+//
+// Time is simulated: every port write takes 1us, _delay_us() takes
+// what it says and ds1302_sim_idle() models MCU doing something else.
+// Clock registers tick in 24 and 12 hours modes with optional crystal
+// error. I/O line can be stuck low or high to inject bus faults.
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Chip state {{{
+// registers 0x80..0xBF by (address >> 1) & 0x1F: 0..6 are clock
+// (seconds, minutes, hours, date, month, wday, year), 7 is WP and
+// 8 is trickle charger. raw BCD as on the chip.
+extern uint8_t ds1302_sim_reg[32];
+extern uint8_t ds1302_sim_ram[31];
+
+// I/O line faults
+#define DS1302_SIM_OK      0
+#define DS1302_SIM_IO_LOW  1 // stuck low, e.g. missing chip with pull down
+#define DS1302_SIM_IO_HIGH 2 // stuck high, e.g. missing chip with pull up
+extern uint8_t ds1302_sim_fault;
+
+// DS1302 crystal error, parts per million, positive runs fast
+extern double ds1302_sim_ppm;
+// MCU timer error seen through rtc2_sync_ticks, parts per million
+extern double ds1302_sim_mcu_ppm;
+
+// true time since ds1302_sim_reset, microseconds
+extern double ds1302_sim_time_us;
+
+// transfers (CE rising edges) since ds1302_sim_reset
+extern uint32_t ds1302_sim_transfers;
+// }}}
+
+// powers chip up again: registers, RAM, faults and time are zeroed,
+// clock is running in 24 hours mode without write protection
+void ds1302_sim_reset(void);
+
+// MCU is busy elsewhere for given time, bus is not touched
+void ds1302_sim_idle(double us);
+
+// time passed since last clock register increment, microseconds
+double ds1302_sim_phase_us(void);
+
+// Checks {{{
+// counts expectation, prints formatted message if cond is false.
+// returns cond
+int ds1302_sim_expect(int cond, const char *fmt, ...);
+
+// prints "<name>: N checks, M failed" and returns exit status
+int ds1302_sim_report(const char *name);
+// }}}
+
+// Used by stand-in headers {{{
+volatile uint8_t *ds1302_sim_port(void);
+volatile uint8_t *ds1302_sim_ddr(void);
+uint8_t ds1302_sim_pin(void);
+uint16_t ds1302_sim_tcnt1(void);
+void ds1302_sim_delay_us(double us);
+
+// microseconds of MCU timer (with ds1302_sim_mcu_ppm error), serves
+// as RTC2_SYNC_TIME with default RTC2_SYNC_TICKS_PER_SECOND
+uint32_t rtc2_sync_ticks(void);
+// same in milliseconds, for RTC2_SYNC_TICKS_PER_SECOND 1000
+uint32_t ds1302_sim_ms(void);
+// }}}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
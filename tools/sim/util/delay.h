@@ -0,0 +1,11 @@
+#ifndef __RTC2_SIM_UTIL_DELAY_H__
+#define __RTC2_SIM_UTIL_DELAY_H__
+
+// Host stand-in for <util/delay.h>: delays advance simulated time
+
+#include "ds1302_sim.h"
+
+#define _delay_us(us) ds1302_sim_delay_us(us)
+#define _delay_ms(ms) ds1302_sim_delay_us((ms) * 1000.0)
+
+#endif